@@ -0,0 +1,264 @@
+// Drives the AAsset hooks of FakeAssetManager against a generated asset tree and reports
+// throughput and latency percentiles, as a baseline for changes to the asset backends.
+
+#include <fake_assetmanager.h>
+#include <argparser.h>
+#include <FileUtil.h>
+#include <android/asset_manager.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct AssetHooks {
+    AAsset *(*open)(FakeAssetManager *amgr, const char *filename, int mode);
+    AAssetDir *(*openDir)(FakeAssetManager *amgr, const char *dirname);
+    void (*close)(AAsset *asset);
+    ssize_t (*read)(AAsset *asset, void *buf, size_t count);
+    off64_t (*seek64)(AAsset *asset, off64_t offset, int whence);
+    off64_t (*getLength64)(AAsset *asset);
+    const void *(*getBuffer)(AAsset *asset);
+    void (*dirClose)(AAssetDir *assetDir);
+    const char *(*dirGetNextFileName)(AAssetDir *assetDir);
+
+    AssetHooks() {
+        std::unordered_map<std::string, void *> syms;
+        FakeAssetManager::initHybrisHooks(syms);
+        open = (decltype(open))syms["AAssetManager_open"];
+        openDir = (decltype(openDir))syms["AAssetManager_openDir"];
+        close = (decltype(close))syms["AAsset_close"];
+        read = (decltype(read))syms["AAsset_read"];
+        seek64 = (decltype(seek64))syms["AAsset_seek64"];
+        getLength64 = (decltype(getLength64))syms["AAsset_getLength64"];
+        getBuffer = (decltype(getBuffer))syms["AAsset_getBuffer"];
+        dirClose = (decltype(dirClose))syms["AAssetDir_close"];
+        dirGetNextFileName = (decltype(dirGetNextFileName))syms["AAssetDir_getNextFileName"];
+    }
+};
+
+struct AssetTree {
+    std::string root;
+    std::vector<std::string> smallFiles;
+    std::vector<std::string> largeFiles;
+    std::vector<std::string> missingFiles;
+    std::string deepestDir;
+};
+
+static void writeFile(std::string const &path, std::string const &content) {
+    FILE *f = fopen(path.c_str(), "wb");
+    if(!f) {
+        fprintf(stderr, "Failed to create %s\n", path.c_str());
+        exit(1);
+    }
+    fwrite(content.data(), 1, content.size(), f);
+    fclose(f);
+}
+
+static AssetTree generateTree(std::string root, int smallCount, int largeCount, size_t largeSize, int depth) {
+    AssetTree tree;
+    if(root.back() != '/')
+        root += '/';
+    tree.root = root;
+    std::mt19937 rng(1234);
+
+    // Small json files spread over a resource pack like layout
+    const char *packs[] = {"resource_packs/vanilla/", "resource_packs/chemistry/", "behavior_packs/vanilla/"};
+    const char *kinds[] = {"textures/", "ui/", "materials/", "entity/", "texts/"};
+    for(int i = 0; i < smallCount; i++) {
+        std::string dir = std::string(packs[i % 3]) + kinds[(i / 3) % 5] + "group" + std::to_string(i % 37) + "/";
+        FileUtil::mkdirRecursive(root + dir);
+        std::string name = dir + "asset" + std::to_string(i) + ".json";
+        std::string content = "{\n  \"format_version\": \"1.16.0\",\n  \"id\": " + std::to_string(i) + ",\n  \"data\": \"";
+        content.append(200 + rng() % 3000, (char)('a' + rng() % 26));
+        content += "\"\n}\n";
+        writeFile(root + name, content);
+        tree.smallFiles.push_back(name);
+        tree.missingFiles.push_back(dir + "missing" + std::to_string(i) + ".json");
+    }
+
+    FileUtil::mkdirRecursive(root + "sounds/");
+    std::string block(1024 * 1024, '\0');
+    for(int i = 0; i < largeCount; i++) {
+        std::string name = "sounds/bank" + std::to_string(i) + ".bank";
+        FILE *f = fopen((root + name).c_str(), "wb");
+        for(size_t written = 0; written < largeSize; written += block.size()) {
+            for(auto &c : block)
+                c = (char)rng();
+            fwrite(block.data(), 1, std::min(block.size(), largeSize - written), f);
+        }
+        fclose(f);
+        tree.largeFiles.push_back(name);
+    }
+
+    std::string deep;
+    for(int i = 0; i < depth; i++)
+        deep += "level" + std::to_string(i) + "/";
+    FileUtil::mkdirRecursive(root + deep);
+    writeFile(root + deep + "leaf.json", "{}");
+    tree.smallFiles.push_back(deep + "leaf.json");
+    tree.deepestDir = deep;
+    return tree;
+}
+
+// Evicts the tree from the page cache without root, so the cold pass really hits the disk
+static void dropPageCache(AssetTree const &tree) {
+#ifdef POSIX_FADV_DONTNEED
+    for(auto list : {&tree.smallFiles, &tree.largeFiles}) {
+        for(auto &&name : *list) {
+            int fd = open((tree.root + name).c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0)
+                continue;
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+#else
+    fprintf(stderr, "posix_fadvise is not available, the cold pass runs with a warm page cache\n");
+#endif
+}
+
+struct Result {
+    std::string name;
+    std::vector<double> latencies;
+    uint64_t bytes = 0;
+    double seconds = 0;
+};
+
+static Result measure(std::string name, size_t ops, std::function<uint64_t(size_t)> const &op) {
+    Result result;
+    result.name = std::move(name);
+    result.latencies.reserve(ops);
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < ops; i++) {
+        auto opStart = std::chrono::steady_clock::now();
+        result.bytes += op(i);
+        result.latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - opStart).count());
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static double percentile(std::vector<double> sorted, double p) {
+    if(sorted.empty())
+        return 0;
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+static std::vector<Result> runPass(AssetHooks const &hooks, AssetTree const &tree, FakeAssetManager &amgr) {
+    std::vector<Result> results;
+    std::vector<char> buf(64 * 1024);
+
+    results.push_back(measure("open_read_small", tree.smallFiles.size(), [&](size_t i) {
+        auto asset = hooks.open(&amgr, tree.smallFiles[i].c_str(), AASSET_MODE_UNKNOWN);
+        uint64_t total = 0;
+        for(ssize_t r; (r = hooks.read(asset, buf.data(), buf.size())) > 0;)
+            total += r;
+        hooks.close(asset);
+        return total;
+    }));
+    results.push_back(measure("open_getbuffer_small", tree.smallFiles.size(), [&](size_t i) {
+        auto asset = hooks.open(&amgr, tree.smallFiles[i].c_str(), AASSET_MODE_BUFFER);
+        auto length = hooks.getLength64(asset);
+        volatile char sink = 0;
+        auto data = (const char *)hooks.getBuffer(asset);
+        for(off64_t o = 0; o < length; o += 4096)
+            sink += data[o];
+        hooks.close(asset);
+        return (uint64_t)length;
+    }));
+    results.push_back(measure("open_missing", tree.missingFiles.size(), [&](size_t i) {
+        auto asset = hooks.open(&amgr, tree.missingFiles[i].c_str(), AASSET_MODE_UNKNOWN);
+        if(asset)
+            hooks.close(asset);
+        return (uint64_t)0;
+    }));
+    results.push_back(measure("stream_large", tree.largeFiles.size(), [&](size_t i) {
+        auto asset = hooks.open(&amgr, tree.largeFiles[i].c_str(), AASSET_MODE_STREAMING);
+        uint64_t total = 0;
+        for(ssize_t r; (r = hooks.read(asset, buf.data(), 16 * 1024)) > 0;)
+            total += r;
+        hooks.close(asset);
+        return total;
+    }));
+    std::mt19937 rng(42);
+    AAsset *asset = nullptr;
+    results.push_back(measure("random_seek_read_large", tree.largeFiles.size() * 256, [&](size_t i) {
+        if(i % 256 == 0)
+            asset = hooks.open(&amgr, tree.largeFiles[i / 256].c_str(), AASSET_MODE_RANDOM);
+        hooks.seek64(asset, rng() % std::max<off64_t>(1, hooks.getLength64(asset) - 4096), SEEK_SET);
+        uint64_t r = (uint64_t)std::max<ssize_t>(0, hooks.read(asset, buf.data(), 4096));
+        if(i % 256 == 255)
+            hooks.close(asset);
+        return r;
+    }));
+    std::vector<std::string> dirs = {"", tree.deepestDir};
+    for(auto &&f : tree.smallFiles)
+        dirs.push_back(f.substr(0, f.rfind('/')));
+    std::sort(dirs.begin(), dirs.end());
+    dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+    results.push_back(measure("list_dir", dirs.size(), [&](size_t i) {
+        auto dir = hooks.openDir(&amgr, dirs[i].c_str());
+        if(dir) {
+            while(hooks.dirGetNextFileName(dir)) {
+            }
+            hooks.dirClose(dir);
+        }
+        return (uint64_t)0;
+    }));
+    return results;
+}
+
+int main(int argc, char *argv[]) {
+    argparser::arg_parser p;
+    argparser::arg<std::string> dir(p, "--dir", "-d", "Directory to generate the synthetic asset tree in", "/tmp/mcpelauncher-asset-benchmark");
+    argparser::arg<int> smallCount(p, "--small", "-s", "Number of small json assets", 5000);
+    argparser::arg<int> largeCount(p, "--large", "-l", "Number of large binary assets", 4);
+    argparser::arg<int> largeSizeMb(p, "--large-size", "-ls", "Size of every large asset in MiB", 32);
+    argparser::arg<int> depth(p, "--depth", "-dp", "Depth of the deepest directory", 16);
+    argparser::arg<int> warmPasses(p, "--warm-passes", "-w", "Number of warm cache passes", 3);
+    argparser::arg<std::string> output(p, "--output", "-o", "Also write the results as json to this file", "");
+    if(!p.parse(argc, (const char **)argv))
+        return 1;
+
+    auto tree = generateTree(dir, smallCount, largeCount, (size_t)largeSizeMb.get() * 1024 * 1024, depth);
+    AssetHooks hooks;
+
+    FILE *json = output.get().empty() ? nullptr : fopen(output.get().c_str(), "w");
+    if(json)
+        fprintf(json, "[");
+    printf("%-6s %-24s %10s %12s %12s %10s %10s\n", "pass", "workload", "ops", "ops/s", "MiB/s", "p50 us", "p99 us");
+    bool first = true;
+    // The cold pass starts with an evicted page cache and a new manager, so it includes building the index.
+    // Warm passes reuse the manager with its index and asset cache.
+    dropPageCache(tree);
+    FakeAssetManager amgr(tree.root);
+    for(int pass = 0; pass <= warmPasses; pass++) {
+        const char *passName = pass == 0 ? "cold" : "warm";
+        for(auto &&r : runPass(hooks, tree, amgr)) {
+            double p50 = percentile(r.latencies, 0.5), p99 = percentile(r.latencies, 0.99);
+            double opsPerSec = r.latencies.size() / r.seconds, mibPerSec = r.bytes / r.seconds / (1024 * 1024);
+            printf("%-6s %-24s %10zu %12.0f %12.1f %10.1f %10.1f\n", passName, r.name.c_str(), r.latencies.size(), opsPerSec, mibPerSec, p50, p99);
+            if(json) {
+                fprintf(json, "%s\n  {\"pass\": \"%s\", \"index\": %d, \"workload\": \"%s\", \"ops\": %zu, \"ops_per_sec\": %.1f, \"mib_per_sec\": %.2f, \"p50_us\": %.2f, \"p99_us\": %.2f}",
+                        first ? "" : ",", passName, pass, r.name.c_str(), r.latencies.size(), opsPerSec, mibPerSec, p50, p99);
+                first = false;
+            }
+        }
+    }
+    if(json) {
+        fprintf(json, "\n]\n");
+        fclose(json);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Measures iTLB misses and run time of a jump chain through a large file backed code mapping,
+// before and after CodeHugePages::remap, as a stand in for the code segment of the game.
+
+#include <code_huge_pages.h>
+#include <argparser.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+static const size_t pageSize = 4096;
+
+// Every page jumps to the next page of a random permutation, the last one returns
+static std::vector<unsigned char> generateChain(size_t size) {
+    size_t pages = size / pageSize;
+    std::vector<unsigned char> code(pages * pageSize, 0);
+    std::vector<size_t> order(pages);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 rng(1234);
+    std::shuffle(order.begin() + 1, order.end(), rng);
+    for(size_t i = 0; i < pages; i++) {
+        auto at = code.data() + order[i] * pageSize;
+#if defined(__x86_64__) || defined(__i386__)
+        if(i + 1 == pages) {
+            at[0] = 0xC3;  // ret
+        } else {
+            int32_t rel = (int32_t)((int64_t)order[i + 1] * pageSize - ((int64_t)order[i] * pageSize + 5));
+            at[0] = 0xE9;  // jmp rel32
+            memcpy(at + 1, &rel, 4);
+        }
+#elif defined(__aarch64__)
+        uint32_t insn = 0xD65F03C0;  // ret
+        if(i + 1 != pages)
+            insn = 0x14000000 | (uint32_t)((((int64_t)order[i + 1] - (int64_t)order[i]) * (int64_t)(pageSize / 4)) & 0x3FFFFFF);  // b
+        memcpy(at, &insn, 4);
+#else
+#error "Unsupported architecture"
+#endif
+    }
+    return code;
+}
+
+static int openItlbCounter() {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_ITLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+struct Result {
+    const char *name;
+    double nsPerPage;
+    double missesPerPage;  // -1 if the counter isn't available
+    size_t hugeBytes;
+};
+
+static Result measure(const char *name, void *code, size_t size, int iterations) {
+    auto fn = (void (*)())code;
+    fn();  // fault everything in
+    int counter = openItlbCounter();
+    if(counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; i++)
+        fn();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long long misses = -1;
+    if(counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(counter, &misses, sizeof(misses)) != sizeof(misses))
+            misses = -1;
+        close(counter);
+    }
+    double visits = (double)iterations * (size / pageSize);
+    return {name, seconds * 1e9 / visits, misses < 0 ? -1 : misses / visits, CodeHugePages::getHugePageBytes(code, size)};
+}
+
+int main(int argc, char *argv[]) {
+    argparser::arg_parser p;
+    argparser::arg<int> sizeMb(p, "--size", "-s", "Size of the code mapping in MiB", 128);
+    argparser::arg<int> iterations(p, "--iterations", "-i", "Runs through the whole chain per measurement", 20);
+    argparser::arg<std::string> dir(p, "--dir", "-d", "Directory for the generated code file", "/tmp");
+    argparser::arg<std::string> output(p, "--output", "-o", "Also write the results as json to this file", "");
+    if(!p.parse(argc, (const char **)argv))
+        return 1;
+#if defined(__aarch64__)
+    // b reaches +-128 MiB
+    size_t size = (size_t)std::min(sizeMb.get(), 127) * 1024 * 1024;
+#else
+    size_t size = (size_t)sizeMb.get() * 1024 * 1024;
+#endif
+
+    // A file backed private executable mapping, like the code segment mapped by the linker
+    auto path = dir.get() + "/mcpelauncher-huge-page-benchmark.bin";
+    auto code = generateChain(size);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0 || write(fd, code.data(), code.size()) != (ssize_t)code.size()) {
+        perror("Failed to write the code file");
+        return 1;
+    }
+    // Map at a huge page aligned address, so the whole chain is eligible
+    auto reserved = (uintptr_t)mmap(nullptr, size + CodeHugePages::hugePageSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    auto aligned = (reserved + CodeHugePages::hugePageSize - 1) & ~(uintptr_t)(CodeHugePages::hugePageSize - 1);
+    void *mapping = mmap((void *)aligned, size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    close(fd);
+    unlink(path.c_str());
+    if(mapping == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    // A tmpfs with huge=always would otherwise back the baseline with huge pages as well
+    madvise(mapping, size, MADV_NOHUGEPAGE);
+
+    std::vector<Result> results;
+    results.push_back(measure("file_4k", mapping, size, iterations));
+    if(!CodeHugePages::remap(mapping, size)) {
+        fprintf(stderr, "CodeHugePages::remap failed\n");
+        return 1;
+    }
+    results.push_back(measure("remapped_thp", mapping, size, iterations));
+
+    printf("%-14s %12s %16s %10s\n", "variant", "ns/page", "itlb misses/page", "huge MiB");
+    for(auto &&r : results) {
+        char misses[32] = "n/a";
+        if(r.missesPerPage >= 0)
+            snprintf(misses, sizeof(misses), "%.3f", r.missesPerPage);
+        printf("%-14s %12.2f %16s %10.1f\n", r.name, r.nsPerPage, misses, r.hugeBytes / (1024.0 * 1024.0));
+    }
+    if(!output.get().empty()) {
+        FILE *json = fopen(output.get().c_str(), "w");
+        if(json) {
+            fprintf(json, "[");
+            for(size_t i = 0; i < results.size(); i++) {
+                fprintf(json, "%s\n  {\"variant\": \"%s\", \"size_mib\": %zu, \"ns_per_page\": %.3f, \"itlb_misses_per_page\": %.4f, \"huge_page_mib\": %.1f}", i ? "," : "", results[i].name,
+                        size / (1024 * 1024), results[i].nsPerPage, results[i].missesPerPage, results[i].hugeBytes / (1024.0 * 1024.0));
+            }
+            fprintf(json, "\n]\n");
+            fclose(json);
+        }
+    }
+    return 0;
+}
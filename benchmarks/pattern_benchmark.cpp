@@ -0,0 +1,200 @@
+// Compares PatternScanner against searching the patterns one at a time like PatchUtils::patternSearch,
+// over a generated code like buffer or the bytes of a real library.
+
+#include <pattern_scanner.h>
+#include <argparser.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// The patterns of GLCorePatch, followed by generated ones
+static const char *knownPatterns[] = {
+    "53 83 EC 18 E8 00 00 00 00 5B 81 C3 ?? ?? ?? ?? 8B 83 ?? ?? ?? ?? 85 C0 79 5F 8D 44 24 08 89 04 24 E8 ?? ?? ?? ?? 83 EC 04 8B 44 24 08 83 F8 02",
+    "8B 15 ?? ?? ?? ?? 85 D2 78 07 83 FA 01 0F 94 C0 C3 50 E8 ?? ?? ?? ?? C1 EA 10 F7 D2 83 E2 01 89",
+    "50 ?? ?? ?? ?? ?? ?? 85 d2 ?? ?? ?? ?? ?? ?? ?? c1 ea 10 f7 d2 83 e2 01",
+};
+
+struct ParsedPattern {
+    std::vector<unsigned char> bytes;
+    std::vector<bool> wildcard;
+};
+
+static ParsedPattern parse(std::string const &pattern) {
+    ParsedPattern ret;
+    for(size_t i = 0; i + 1 < pattern.size(); i += 3) {
+        bool wildcard = pattern[i] == '?';
+        ret.wildcard.push_back(wildcard);
+        ret.bytes.push_back(wildcard ? 0 : (unsigned char)strtoul(pattern.substr(i, 2).c_str(), nullptr, 16));
+    }
+    return ret;
+}
+
+// The byte by byte loop of PatchUtils::patternSearch, which needs a library loaded by the linker
+static const unsigned char *naiveSearch(const unsigned char *data, size_t size, ParsedPattern const &pattern) {
+    for(size_t i = 0; i + pattern.bytes.size() <= size; i++) {
+        size_t j = 0;
+        for(; j < pattern.bytes.size(); j++) {
+            if(!pattern.wildcard[j] && data[i + j] != pattern.bytes[j])
+                break;
+        }
+        if(j == pattern.bytes.size())
+            return data + i;
+    }
+    return nullptr;
+}
+
+// x86 like byte distribution, with the patterns planted close to the end so every search covers the whole buffer
+static std::vector<unsigned char> generateCode(size_t size, std::vector<std::string> const &patterns) {
+    std::vector<unsigned char> data(size);
+    std::mt19937 rng(1234);
+    const unsigned char common[] = {0x00, 0xFF, 0x48, 0x89, 0x8B, 0x83, 0xE8, 0x0F, 0x24, 0x90, 0xCC, 0xC3};
+    for(auto &b : data)
+        b = rng() % 3 == 0 ? common[rng() % sizeof(common)] : (unsigned char)rng();
+    size_t offset = size - 4096;
+    for(auto &&pattern : patterns) {
+        auto parsed = parse(pattern);
+        if(offset + parsed.bytes.size() > size)
+            break;
+        for(size_t i = 0; i < parsed.bytes.size(); i++) {
+            if(!parsed.wildcard[i])
+                data[offset + i] = parsed.bytes[i];
+        }
+        offset += parsed.bytes.size() + 7;
+    }
+    return data;
+}
+
+static std::string generatePattern(std::mt19937 &rng) {
+    std::string ret;
+    size_t length = 12 + rng() % 20;
+    for(size_t i = 0; i < length; i++) {
+        char byte[4];
+        if(i > 0 && rng() % 4 == 0)
+            snprintf(byte, sizeof(byte), "?? ");
+        else
+            snprintf(byte, sizeof(byte), "%02X ", (unsigned)(rng() & 0xFF));
+        ret += byte;
+    }
+    ret.pop_back();
+    return ret;
+}
+
+static double measure(int iterations, std::function<size_t()> const &run, size_t &hits) {
+    double best = 1e30;
+    for(int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        hits = run();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    argparser::arg_parser p;
+    argparser::arg<std::string> file(p, "--file", "-f", "Scan the bytes of this file (e.g. libminecraftpe.so) instead of generated code", "");
+    argparser::arg<int> sizeMb(p, "--size", "-s", "Size of the generated code in MiB", 64);
+    argparser::arg<int> extraPatterns(p, "--patterns", "-p", "Number of generated patterns in addition to the GLCorePatch ones", 13);
+    argparser::arg<int> iterations(p, "--iterations", "-i", "Runs of every variant, the fastest one is reported", 5);
+    argparser::arg<std::string> output(p, "--output", "-o", "Also write the results as json to this file", "");
+    if(!p.parse(argc, (const char **)argv))
+        return 1;
+
+    std::vector<std::string> patterns(std::begin(knownPatterns), std::end(knownPatterns));
+    std::mt19937 rng(42);
+    for(int i = 0; i < extraPatterns; i++)
+        patterns.push_back(generatePattern(rng));
+
+    std::vector<unsigned char> generated;
+    const unsigned char *data;
+    size_t size;
+    if(!file.get().empty()) {
+        int fd = open(file.get().c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if(fd < 0 || fstat(fd, &st) != 0) {
+            fprintf(stderr, "Failed to open %s\n", file.get().c_str());
+            return 1;
+        }
+        size = (size_t)st.st_size;
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+        void *m = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+        close(fd);
+        if(m == MAP_FAILED) {
+            fprintf(stderr, "Failed to map %s\n", file.get().c_str());
+            return 1;
+        }
+        data = (const unsigned char *)m;
+    } else {
+        generated = generateCode((size_t)sizeMb.get() * 1024 * 1024, patterns);
+        data = generated.data();
+        size = generated.size();
+    }
+
+    PatternScanner scanner;
+    std::vector<ParsedPattern> parsed;
+    for(auto &&pattern : patterns) {
+        scanner.add(pattern);
+        parsed.push_back(parse(pattern));
+    }
+
+    FILE *json = output.get().empty() ? nullptr : fopen(output.get().c_str(), "w");
+    if(json)
+        fprintf(json, "[");
+    printf("%zu patterns over %.1f MiB\n", patterns.size(), size / (1024.0 * 1024.0));
+    printf("%-24s %10s %10s %10s %8s\n", "variant", "ms", "MiB/s", "speedup", "hits");
+    double baseline = 0;
+    auto report = [&](const char *name, double seconds, size_t hits) {
+        if(baseline == 0)
+            baseline = seconds;
+        double mibPerSec = size / seconds / (1024 * 1024);
+        printf("%-24s %10.2f %10.1f %9.1fx %8zu\n", name, seconds * 1000, mibPerSec, baseline / seconds, hits);
+        if(json)
+            fprintf(json, "%s\n  {\"variant\": \"%s\", \"ms\": %.3f, \"mib_per_sec\": %.1f, \"speedup\": %.2f, \"hits\": %zu}", baseline == seconds ? "" : ",", name, seconds * 1000, mibPerSec, baseline / seconds, hits);
+    };
+
+    size_t hits;
+    double seconds = measure(iterations, [&]() {
+        size_t found = 0;
+        for(auto &&pattern : parsed)
+            found += naiveSearch(data, size, pattern) != nullptr;
+        return found;
+    }, hits);
+    report("patternSearch (each)", seconds, hits);
+
+    std::vector<PatternScanner::Match> reference;
+    for(auto implementation : {PatternScanner::Implementation::SCALAR, PatternScanner::Implementation::SSE2, PatternScanner::Implementation::AVX2, PatternScanner::Implementation::NEON}) {
+        if(!PatternScanner::isSupported(implementation))
+            continue;
+        std::vector<PatternScanner::Match> matches;
+        seconds = measure(iterations, [&]() {
+            matches = scanner.scan(data, size, implementation);
+            return matches.size();
+        }, hits);
+        report((std::string("PatternScanner ") + PatternScanner::getName(implementation)).c_str(), seconds, hits);
+        if(implementation == PatternScanner::Implementation::SCALAR) {
+            reference = matches;
+        } else if(matches.size() != reference.size() || !std::equal(matches.begin(), matches.end(), reference.begin(), [](PatternScanner::Match const &a, PatternScanner::Match const &b) {
+                      return a.pattern == b.pattern && a.offset == b.offset;
+                  })) {
+            fprintf(stderr, "%s disagrees with the scalar scanner\n", PatternScanner::getName(implementation));
+            return 1;
+        }
+    }
+    if(json) {
+        fprintf(json, "\n]\n");
+        fclose(json);
+    }
+    return 0;
+}
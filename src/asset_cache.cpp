@@ -0,0 +1,101 @@
+#include "asset_cache.h"
+#include <sys/mman.h>
+
+AssetContent::AssetContent(std::string content) : allocated(true), heap(std::move(content)) {
+    data = heap.data();
+    size = heap.size();
+}
+
+AssetContent::AssetContent(void *mapping, size_t size) : mapping(mapping) {
+    data = (const char *)mapping;
+    this->size = size;
+}
+
+AssetContent::AssetContent(const char *data, size_t size) {
+    this->data = data;
+    this->size = size;
+}
+
+AssetContent::~AssetContent() {
+    if(mapping)
+        munmap(mapping, size);
+}
+
+void AssetCache::evict() {
+    auto it = lru.end();
+    while(bytes > byteBudget && it != lru.begin()) {
+        --it;
+        // Entries which are still loading don't count towards the budget yet
+        if(it->size == 0)
+            continue;
+        bytes -= it->size;
+        evictions++;
+        items.erase(it->path);
+        it = lru.erase(it);
+    }
+}
+
+void AssetCache::setByteBudget(size_t budget) {
+    std::lock_guard<std::mutex> lock(mutex);
+    byteBudget = budget;
+    evict();
+}
+
+std::shared_ptr<const AssetContent> AssetCache::getOrLoad(std::string const &path, std::function<std::shared_ptr<const AssetContent>()> const &load) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if(byteBudget == 0) {
+        misses++;
+        lock.unlock();
+        return load();
+    }
+    auto it = items.find(path);
+    if(it != items.end()) {
+        hits++;
+        lru.splice(lru.begin(), lru, it->second);
+        auto content = it->second->content;
+        lock.unlock();
+        return content.get();
+    }
+    misses++;
+    std::promise<std::shared_ptr<const AssetContent>> promise;
+    uint64_t id = nextId++;
+    lru.push_front({path, id, promise.get_future().share()});
+    items[path] = lru.begin();
+    lock.unlock();
+
+    std::shared_ptr<const AssetContent> content;
+    try {
+        content = load();
+    } catch(...) {
+        // Waiters get the same exception, and the next open of the path loads it again
+        promise.set_exception(std::current_exception());
+        lock.lock();
+        it = items.find(path);
+        if(it != items.end() && it->second->id == id) {
+            lru.erase(it->second);
+            items.erase(it);
+        }
+        throw;
+    }
+    promise.set_value(content);
+
+    lock.lock();
+    it = items.find(path);
+    if(it != items.end() && it->second->id == id) {
+        if(!content || content->size == 0 || content->size > byteBudget) {
+            // Failed opens are retried next time and oversized assets would evict everything else
+            lru.erase(it->second);
+            items.erase(it);
+        } else {
+            it->second->size = content->size;
+            bytes += content->size;
+            evict();
+        }
+    }
+    return content;
+}
+
+AssetCache::Stats AssetCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return {hits, misses, evictions, items.size(), bytes, byteBudget};
+}
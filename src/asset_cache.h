@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Immutable content of an asset, shared by every AAsset opened on it
+struct AssetContent {
+    const char *data = nullptr;
+    size_t size = 0;
+    // Whether data lives on the heap, as opposed to a file or archive mapping
+    bool allocated = false;
+
+private:
+    std::string heap;
+    void *mapping = nullptr;
+
+public:
+    explicit AssetContent(std::string content);
+    // Takes ownership of a mapping of exactly size bytes
+    AssetContent(void *mapping, size_t size);
+    // Borrows memory that outlives the content, like the mapping of an archive
+    AssetContent(const char *data, size_t size);
+
+    AssetContent(AssetContent const &) = delete;
+    AssetContent &operator=(AssetContent const &) = delete;
+
+    ~AssetContent();
+};
+
+// Byte budgeted LRU cache of asset contents, keyed by the normalized asset path
+class AssetCache {
+public:
+    struct Stats {
+        uint64_t hits, misses, evictions;
+        size_t entries, bytes, byteBudget;
+    };
+
+private:
+    struct Item {
+        std::string path;
+        uint64_t id;
+        std::shared_future<std::shared_ptr<const AssetContent>> content;
+        size_t size = 0;
+    };
+
+    mutable std::mutex mutex;
+    std::list<Item> lru;
+    std::unordered_map<std::string, std::list<Item>::iterator> items;
+    size_t byteBudget;
+    size_t bytes = 0;
+    uint64_t nextId = 0;
+    uint64_t hits = 0, misses = 0, evictions = 0;
+
+    void evict();
+
+public:
+    explicit AssetCache(size_t byteBudget = 64 * 1024 * 1024) : byteBudget(byteBudget) {}
+
+    // A budget of 0 disables caching
+    void setByteBudget(size_t budget);
+
+    // Returns the cached content, or calls load once even if several threads miss on the same path at the same time
+    std::shared_ptr<const AssetContent> getOrLoad(std::string const &path, std::function<std::shared_ptr<const AssetContent>()> const &load);
+
+    Stats getStats() const;
+};
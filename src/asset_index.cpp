@@ -0,0 +1,118 @@
+#include "asset_index.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <cstring>
+#include <log.h>
+
+std::string AssetIndex::normalizePath(const char *path) {
+    std::string ret;
+    const char *p = path;
+    while(*p) {
+        const char *end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if(len == 0 || (len == 1 && p[0] == '.')) {
+            // skip empty and current directory components
+        } else if(len == 2 && p[0] == '.' && p[1] == '.') {
+            auto slash = ret.rfind('/');
+            ret.erase(slash == std::string::npos ? 0 : slash);
+        } else {
+            if(!ret.empty())
+                ret += '/';
+            ret.append(p, len);
+        }
+        p += len;
+        if(*p == '/')
+            p++;
+    }
+    return ret;
+}
+
+AssetIndex::Entry *AssetIndex::insert(std::string const &path, bool directory) {
+    auto it = entries.find(path);
+    if(it != entries.end()) {
+        // Directories merge, anything else is shadowed by the existing entry
+        return directory && it->second.directory ? &it->second : nullptr;
+    }
+    if(!path.empty()) {
+        auto slash = path.rfind('/');
+        Entry *parent = insert(slash == std::string::npos ? std::string() : path.substr(0, slash), true);
+        if(!parent)
+            return nullptr;
+        parent->children.push_back(slash == std::string::npos ? path : path.substr(slash + 1));
+    }
+    Entry &entry = entries[path];
+    entry.directory = directory;
+    return &entry;
+}
+
+void AssetIndex::scanDirectory(std::string const &rootDir, std::string const &path, std::vector<std::pair<uint64_t, uint64_t>> &visited) {
+    std::string fullPath = rootDir + path;
+    DIR *d = opendir(fullPath.c_str());
+    if(!d)
+        return;
+    std::vector<std::pair<std::string, std::pair<uint64_t, uint64_t>>> subdirs;
+    while(dirent *ent = readdir(d)) {
+        if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+            continue;
+        struct stat st;
+        // follow symlinks, resource packs are sometimes linked into the assets tree
+        if(fstatat(dirfd(d), ent->d_name, &st, 0) != 0)
+            continue;
+        if(!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode))
+            continue;
+        std::string childPath = path.empty() ? std::string(ent->d_name) : path + '/' + ent->d_name;
+        if(S_ISDIR(st.st_mode)) {
+            std::pair<uint64_t, uint64_t> id((uint64_t)st.st_dev, (uint64_t)st.st_ino);
+            if(std::find(visited.begin(), visited.end(), id) != visited.end()) {
+                Log::warn("AssetIndex", "Skipping directory loop at '%s'", childPath.c_str());
+                continue;
+            }
+            if(insert(childPath, true))
+                subdirs.emplace_back(ent->d_name, id);
+        } else if(Entry *entry = insert(childPath, false)) {
+            entry->size = (uint64_t)st.st_size;
+            entry->rootDir = &rootDir;
+        }
+    }
+    closedir(d);
+    for(auto &&subdir : subdirs) {
+        visited.push_back(subdir.second);
+        scanDirectory(rootDir, path.empty() ? subdir.first : path + '/' + subdir.first, visited);
+        visited.pop_back();
+    }
+}
+
+bool AssetIndex::addDirectory(std::string const &rootDir) {
+    struct stat st;
+    if(stat(rootDir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+        return false;
+    insert("", true);
+    std::vector<std::pair<uint64_t, uint64_t>> visited;
+    visited.emplace_back((uint64_t)st.st_dev, (uint64_t)st.st_ino);
+    scanDirectory(rootDir, "", visited);
+    return true;
+}
+
+void AssetIndex::addArchive(ZipAssetArchive const &archive) {
+    insert("", true);
+    for(auto &&archiveEntry : archive.getEntries()) {
+        auto path = normalizePath(archiveEntry.name.c_str());
+        if(path.empty())
+            continue;
+        if(Entry *entry = insert(path, false)) {
+            entry->size = archiveEntry.uncompressedSize;
+            entry->archive = &archive;
+            entry->archiveEntry = &archiveEntry;
+        }
+    }
+}
+
+AssetIndex::Entry const *AssetIndex::find(std::string const &path) const {
+    auto it = entries.find(path);
+    if(it == entries.end())
+        return nullptr;
+    return &it->second;
+}
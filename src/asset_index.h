@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "zip_asset_archive.h"
+
+// In-memory view of an assets tree, so lookups of missing paths don't need a syscall
+class AssetIndex {
+public:
+    struct Entry {
+        bool directory = false;
+        uint64_t size = 0;
+        std::vector<std::string> children;
+        // Directory the file was found in, with a trailing slash
+        std::string const *rootDir = nullptr;
+        // Set instead of rootDir if the file is served from an archive
+        ZipAssetArchive const *archive = nullptr;
+        ZipAssetArchive::Entry const *archiveEntry = nullptr;
+    };
+
+private:
+    std::unordered_map<std::string, Entry> entries;
+
+    Entry *insert(std::string const &path, bool directory);
+
+    void scanDirectory(std::string const &rootDir, std::string const &path, std::vector<std::pair<uint64_t, uint64_t>> &visited);
+
+public:
+    // Resolves "./", "../", repeated and trailing slashes, the root directory is ""
+    static std::string normalizePath(const char *path);
+
+    // Paths which are already indexed take precedence over the ones added later.
+    // rootDir must end with a slash and outlive the index, entries point to it.
+    bool addDirectory(std::string const &rootDir);
+
+    void addArchive(ZipAssetArchive const &archive);
+
+    Entry const *find(std::string const &path) const;
+
+    size_t size() const { return entries.size(); }
+};
@@ -0,0 +1,147 @@
+#include "asset_prefetch.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <log.h>
+#include <mcpelauncher/path_helper.h>
+
+std::atomic_bool AssetPrefetch::recording;
+std::mutex AssetPrefetch::recordMutex;
+std::vector<std::string> AssetPrefetch::recorded;
+std::unordered_set<std::string> AssetPrefetch::recordedSet;
+
+std::string AssetPrefetch::getManifestPath() {
+    return PathHelper::getPrimaryDataDirectory() + "asset-prefetch-manifest.txt";
+}
+
+// Manifest lines are relative asset paths, anything which could escape the assets root is ignored
+static bool isAssetPath(std::string const &path) {
+    if(path.empty() || path[0] == '/')
+        return false;
+    for(size_t start = 0; start <= path.size();) {
+        size_t end = path.find('/', start);
+        if(end == std::string::npos)
+            end = path.size();
+        if(path.compare(start, end - start, "..") == 0)
+            return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+void AssetPrefetch::prefetch(AssetIndex const &index) {
+    // A file or a range of an archive, the threads outlive neither the index nor its layers this way
+    struct Range {
+        std::string file;
+        off_t offset;
+        off_t length;
+    };
+    struct State {
+        std::vector<Range> ranges;
+        std::atomic_size_t next{0};
+        std::atomic_uint running{0};
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    };
+    auto state = std::make_shared<State>();
+    size_t rejected = 0;
+    std::ifstream manifest(getManifestPath());
+    for(std::string line; std::getline(manifest, line);) {
+        if(line.empty())
+            continue;
+        if(!isAssetPath(line)) {
+            rejected++;
+            continue;
+        }
+        auto entry = index.find(line);
+        if(!entry || entry->directory)
+            continue;
+        if(entry->archive) {
+            // The local header and the extra field before the data are small, the range may end a few bytes early
+            state->ranges.push_back({entry->archive->getPath(), (off_t)entry->archiveEntry->localHeaderOffset, (off_t)entry->archiveEntry->compressedSize + 1024});
+        } else {
+            state->ranges.push_back({*entry->rootDir + line, 0, 0});
+        }
+    }
+    if(rejected)
+        Log::warn("AssetPrefetch", "Ignored %zu manifest entries outside of the assets", rejected);
+    if(state->ranges.empty())
+        return;
+
+    // Cold starts are dominated by seek latency, so keep a few requests in flight instead of one
+    unsigned int workers = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+    state->running = workers;
+    for(unsigned int i = 0; i < workers; i++) {
+        std::thread([state]() {
+#ifndef POSIX_FADV_WILLNEED
+            std::unique_ptr<char[]> buf;
+#endif
+            for(size_t i; (i = state->next++) < state->ranges.size();) {
+                auto &range = state->ranges[i];
+                int fd = open(range.file.c_str(), O_RDONLY | O_CLOEXEC);
+                if(fd < 0)
+                    continue;
+#ifdef POSIX_FADV_WILLNEED
+                // A length of 0 means up to the end of the file
+                posix_fadvise(fd, range.offset, range.length, POSIX_FADV_WILLNEED);
+#else
+                if(!buf)
+                    buf.reset(new char[64 * 1024]);
+                for(off_t offset = range.offset; range.length == 0 || offset < range.offset + range.length;) {
+                    ssize_t n = pread(fd, buf.get(), 64 * 1024, offset);
+                    if(n <= 0)
+                        break;
+                    offset += n;
+                }
+#endif
+                close(fd);
+            }
+            if(--state->running == 0) {
+                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - state->start).count();
+                Log::info("AssetPrefetch", "Prefetched %zu assets in %lli ms", state->ranges.size(), (long long)ms);
+            }
+        }).detach();
+    }
+}
+
+void AssetPrefetch::startRecording(std::chrono::seconds window) {
+    recording = true;
+    std::thread([window]() {
+        std::this_thread::sleep_for(window);
+        recording = false;
+        saveManifest();
+    }).detach();
+}
+
+void AssetPrefetch::recordOpenSlow(std::string const &path) {
+    std::lock_guard<std::mutex> lock(recordMutex);
+    if(recording && recordedSet.insert(path).second)
+        recorded.push_back(path);
+}
+
+void AssetPrefetch::saveManifest() {
+    std::lock_guard<std::mutex> lock(recordMutex);
+    if(recorded.empty())
+        return;
+    auto path = getManifestPath();
+    {
+        std::ofstream manifest(path + ".tmp", std::ios::binary | std::ios::trunc);
+        if(!manifest.is_open()) {
+            Log::warn("AssetPrefetch", "Failed to write %s", path.c_str());
+            return;
+        }
+        for(auto &&asset : recorded)
+            manifest << asset << '\n';
+    }
+    // Rename so a crash while writing doesn't leave a truncated manifest behind
+    if(rename((path + ".tmp").c_str(), path.c_str()) != 0)
+        Log::warn("AssetPrefetch", "Failed to replace %s", path.c_str());
+    else
+        Log::info("AssetPrefetch", "Recorded %zu startup assets", recorded.size());
+    recorded.clear();
+    recordedSet.clear();
+}
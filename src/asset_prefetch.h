@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "asset_index.h"
+
+// Records which assets the game opens during startup and warms the page cache for them on the next launch
+class AssetPrefetch {
+private:
+    static std::atomic_bool recording;
+    static std::mutex recordMutex;
+    static std::vector<std::string> recorded;
+    static std::unordered_set<std::string> recordedSet;
+
+    static void saveManifest();
+
+    static void recordOpenSlow(std::string const &path);
+
+public:
+    static std::string getManifestPath();
+
+    // Reads the assets of the previous manifest on a few background threads, from whichever layer of index serves them
+    static void prefetch(AssetIndex const &index);
+
+    // Collects opened asset paths for the duration of window, then replaces the manifest
+    static void startRecording(std::chrono::seconds window);
+
+    static void recordOpen(std::string const &path) {
+        if(recording.load(std::memory_order_relaxed))
+            recordOpenSlow(path);
+    }
+};
@@ -0,0 +1,97 @@
+#include "asset_stats.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+#include <log.h>
+#include <mcpelauncher/path_helper.h>
+
+std::mutex AssetStats::mutex;
+std::unordered_map<std::string, std::unique_ptr<AssetStats::Counters>> AssetStats::counters;
+std::atomic<uint64_t> AssetStats::failedOpens;
+std::string AssetStats::exitDumpPath;
+
+std::string AssetStats::getDefaultDumpPath() {
+    return PathHelper::getPrimaryDataDirectory() + "asset-stats.json";
+}
+
+AssetStats::Counters *AssetStats::get(std::string const &path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &entry = counters[path];
+    if(!entry)
+        entry = std::make_unique<Counters>();
+    return entry.get();
+}
+
+static void writeJsonString(FILE *f, std::string const &str) {
+    fputc('"', f);
+    for(unsigned char c : str) {
+        if(c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if(c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+bool AssetStats::dump(std::string const &path) {
+    // A snapshot of the counters, the game keeps updating them while this runs
+    struct Row {
+        std::string const *path;
+        uint64_t opens, reads, bytesRead, seeks, openNanos, readNanos;
+        bool bufferUsed;
+    };
+    std::vector<Row> rows;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rows.reserve(counters.size());
+        for(auto &&entry : counters) {
+            auto &c = *entry.second;
+            rows.push_back({&entry.first, c.opens.load(), c.reads.load(), c.bytesRead.load(), c.seeks.load(), c.openNanos.load(), c.readNanos.load(), c.bufferUsed.load()});
+        }
+    }
+    // Most expensive assets first, that's what the dump is read for
+    std::sort(rows.begin(), rows.end(), [](Row const &a, Row const &b) {
+        return a.openNanos + a.readNanos > b.openNanos + b.readNanos;
+    });
+
+    FILE *f = fopen(path.c_str(), "w");
+    if(!f) {
+        Log::error("AssetStats", "Failed to open %s", path.c_str());
+        return false;
+    }
+    bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    if(csv) {
+        fprintf(f, "path,opens,reads,bytes_read,seeks,open_ns,read_ns,buffer_used\n");
+    } else {
+        fprintf(f, "{\n  \"failed_opens\": %" PRIu64 ",\n  \"assets\": [", failedOpens.load());
+    }
+    bool first = true;
+    for(auto &&c : rows) {
+        if(csv) {
+            std::string quoted;
+            for(char ch : *c.path)
+                quoted.append(ch == '"' ? 2 : 1, ch);
+            fprintf(f, "\"%s\",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%d\n", quoted.c_str(),
+                    c.opens, c.reads, c.bytesRead, c.seeks, c.openNanos, c.readNanos, c.bufferUsed ? 1 : 0);
+            continue;
+        }
+        fprintf(f, first ? "\n    {\"path\": " : ",\n    {\"path\": ");
+        writeJsonString(f, *c.path);
+        fprintf(f, ", \"opens\": %" PRIu64 ", \"reads\": %" PRIu64 ", \"bytes_read\": %" PRIu64 ", \"seeks\": %" PRIu64 ", \"open_ns\": %" PRIu64 ", \"read_ns\": %" PRIu64 ", \"buffer_used\": %s}",
+                c.opens, c.reads, c.bytesRead, c.seeks, c.openNanos, c.readNanos, c.bufferUsed ? "true" : "false");
+        first = false;
+    }
+    if(!csv)
+        fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    Log::info("AssetStats", "Wrote statistics of %zu assets to %s", rows.size(), path.c_str());
+    return true;
+}
+
+void AssetStats::dumpOnExit() {
+    if(!exitDumpPath.empty())
+        dump(exitDumpPath);
+}
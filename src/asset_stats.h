@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Always-on per asset I/O counters for the AAsset hooks
+class AssetStats {
+public:
+    struct Counters {
+        std::atomic<uint64_t> opens{0};
+        std::atomic<uint64_t> reads{0};
+        std::atomic<uint64_t> bytesRead{0};
+        std::atomic<uint64_t> seeks{0};
+        std::atomic<uint64_t> openNanos{0};
+        std::atomic<uint64_t> readNanos{0};
+        std::atomic_bool bufferUsed{false};
+    };
+
+    struct Timer {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        uint64_t elapsedNanos() const {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+private:
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::unique_ptr<Counters>> counters;
+    static std::atomic<uint64_t> failedOpens;
+
+public:
+    // Written on exit if not empty, set by --asset-stats
+    static std::string exitDumpPath;
+
+    static std::string getDefaultDumpPath();
+
+    // The returned counters live until the process exits, so open assets can keep a pointer to them
+    static Counters *get(std::string const &path);
+
+    static void recordFailedOpen() {
+        failedOpens.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Writes csv if path ends with .csv, json otherwise
+    static bool dump(std::string const &path);
+
+    static void dumpOnExit();
+};
@@ -0,0 +1,155 @@
+#include "code_huge_pages.h"
+#include "loaded_segments.h"
+#include <sys/mman.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <log.h>
+
+#ifdef __linux__
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+#endif
+
+static const char *TAG = "CodeHugePages";
+
+static bool getAlignedRange(void *start, size_t size, uintptr_t &begin, uintptr_t &end) {
+    begin = ((uintptr_t)start + CodeHugePages::hugePageSize - 1) & ~(uintptr_t)(CodeHugePages::hugePageSize - 1);
+    end = ((uintptr_t)start + size) & ~(uintptr_t)(CodeHugePages::hugePageSize - 1);
+    return end > begin;
+}
+
+#ifdef __linux__
+// The protection of the mappings covering the range, fails if they differ or leave a gap
+static bool getProtection(uintptr_t begin, uintptr_t end, int &prot) {
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    uintptr_t covered = begin;
+    prot = -1;
+    while(std::getline(maps, line) && covered < end) {
+        uintptr_t mapStart, mapEnd;
+        char perms[5];
+        if(sscanf(line.c_str(), "%" SCNxPTR "-%" SCNxPTR " %4s", &mapStart, &mapEnd, perms) != 3 || mapEnd <= covered || mapStart >= end)
+            continue;
+        if(mapStart > covered)
+            return false;
+        int mapProt = (perms[0] == 'r' ? PROT_READ : 0) | (perms[1] == 'w' ? PROT_WRITE : 0) | (perms[2] == 'x' ? PROT_EXEC : 0);
+        if(prot != -1 && prot != mapProt)
+            return false;
+        prot = mapProt;
+        covered = mapEnd;
+    }
+    return covered >= end;
+}
+#endif
+
+bool CodeHugePages::remap(void *start, size_t size) {
+#ifdef __linux__
+    uintptr_t begin, end;
+    if(!getAlignedRange(start, size, begin, end))
+        return false;
+    // Patches write to the code without mprotect, so keep exactly the current protection
+    int prot;
+    if(!getProtection(begin, end, prot)) {
+        Log::warn(TAG, "The range at 0x%" PRIxPTR " isn't mapped with a single protection", begin);
+        return false;
+    }
+    size_t length = end - begin;
+    // Over allocate to get a huge page aligned temporary mapping, mremap keeps the pmd mappings if both sides are aligned
+    auto raw = (uintptr_t)mmap(nullptr, length + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if((void *)raw == MAP_FAILED) {
+        Log::warn(TAG, "mmap failed: %s", strerror(errno));
+        return false;
+    }
+    auto tmp = (raw + hugePageSize - 1) & ~(uintptr_t)(hugePageSize - 1);
+    if(tmp != raw)
+        munmap((void *)raw, tmp - raw);
+    munmap((void *)(tmp + length), raw + hugePageSize - tmp);
+
+    if(madvise((void *)tmp, length, MADV_HUGEPAGE) != 0)
+        Log::warn(TAG, "MADV_HUGEPAGE failed: %s", strerror(errno));
+    memcpy((void *)tmp, (void *)begin, length);
+    // Pages which faulted in as small pages because of fragmentation, not an error on kernels before 6.1
+    madvise((void *)tmp, length, MADV_COLLAPSE);
+    if(mprotect((void *)tmp, length, prot) != 0 || mremap((void *)tmp, length, length, MREMAP_MAYMOVE | MREMAP_FIXED, (void *)begin) == MAP_FAILED) {
+        Log::warn(TAG, "Failed to replace the code mapping: %s", strerror(errno));
+        munmap((void *)tmp, length);
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CodeHugePages::advise(void *start, size_t size) {
+#ifdef __linux__
+    uintptr_t begin, end;
+    if(!getAlignedRange(start, size, begin, end))
+        return false;
+    if(madvise((void *)begin, end - begin, MADV_HUGEPAGE) != 0) {
+        Log::warn(TAG, "MADV_HUGEPAGE failed: %s", strerror(errno));
+        return false;
+    }
+    if(madvise((void *)begin, end - begin, MADV_COLLAPSE) != 0)
+        Log::debug(TAG, "MADV_COLLAPSE failed, leaving it to khugepaged: %s", strerror(errno));
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t CodeHugePages::getHugePageBytes(void *start, size_t size) {
+    size_t ret = 0;
+#ifdef __linux__
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool overlaps = false;
+    while(std::getline(smaps, line)) {
+        uintptr_t mapStart, mapEnd;
+        size_t kb;
+        if(sscanf(line.c_str(), "%" SCNxPTR "-%" SCNxPTR " ", &mapStart, &mapEnd) == 2) {
+            overlaps = mapStart < (uintptr_t)start + size && mapEnd > (uintptr_t)start;
+        } else if(overlaps && (sscanf(line.c_str(), "AnonHugePages: %zu kB", &kb) == 1 || sscanf(line.c_str(), "FilePmdMapped: %zu kB", &kb) == 1)) {
+            ret += kb * 1024;
+        }
+    }
+#endif
+    return ret;
+}
+
+void CodeHugePages::apply(void *handle) {
+#ifdef __linux__
+    std::ifstream enabledFile("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string enabled;
+    std::getline(enabledFile, enabled);
+    if(enabled.find("[never]") != std::string::npos) {
+        Log::warn(TAG, "Transparent huge pages are disabled in /sys/kernel/mm/transparent_hugepage/enabled");
+        return;
+    }
+    auto segments = getLoadedSegments(handle);
+    if(segments.empty()) {
+        Log::error(TAG, "The library base doesn't point to an ELF header");
+        return;
+    }
+    for(auto &&segment : segments) {
+        if(!segment.isCode())
+            continue;
+        bool remapped = remap(segment.start, segment.size);
+        if(!remapped && !advise(segment.start, segment.size))
+            continue;
+        Log::info(TAG, "%s the code segment at 0x%" PRIxPTR ", %.1f of %.1f MiB are backed by huge pages", remapped ? "Remapped" : "Advised", (uintptr_t)segment.start,
+                  getHugePageBytes(segment.start, segment.size) / (1024.0 * 1024.0), segment.size / (1024.0 * 1024.0));
+    }
+#else
+    Log::warn(TAG, "Huge pages for the game code are only supported on linux");
+#endif
+}
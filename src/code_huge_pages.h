@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+// Backs the code of the game with transparent huge pages to reduce iTLB misses, only supported on linux
+class CodeHugePages {
+public:
+    static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+
+    // Copies the huge page aligned part of the range onto anonymous MADV_HUGEPAGE memory, which then replaces it at the same address
+    // with the protection it had before
+    static bool remap(void *start, size_t size);
+
+    // MADV_HUGEPAGE and MADV_COLLAPSE on the huge page aligned part, file backed code needs CONFIG_READ_ONLY_THP_FOR_FS for this
+    static bool advise(void *start, size_t size);
+
+    // AnonHugePages and FilePmdMapped of the mappings overlapping the range, from /proc/self/smaps
+    static size_t getHugePageBytes(void *start, size_t size);
+
+    // Remaps the executable segments of the game, falls back to advise() if that fails
+    static void apply(void *handle);
+};
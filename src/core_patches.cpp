@@ -3,6 +3,7 @@
 #include <mcpelauncher/linker.h>
 #include <mcpelauncher/patch_utils.h>
 #include <log.h>
+#include "symbol_index.h"
 
 CorePatches::GameWindowHandle CorePatches::currentGameWindowHandle;
 std::vector<std::function<void()>> CorePatches::onWindowCreatedCallbacks;
@@ -11,7 +12,7 @@ void CorePatches::install(void* handle) {
     // void* ptr = linker::dlsym(handle, "_ZN3web4http6client7details35verify_cert_chain_platform_specificERN5boost4asio3ssl14verify_contextERKSs");
     // PatchUtils::patchCallInstruction(ptr, (void*) +[]() { return true; }, true);
 
-    void* appPlatform = linker::dlsym(handle, "_ZTV21AppPlatform_android23");
+    void* appPlatform = SymbolIndex::resolve(handle, "_ZTV21AppPlatform_android23");
     if(appPlatform) {
         void** vta = &((void**)appPlatform)[2];
         PatchUtils::VtableReplaceHelper vtr(handle, vta, vta);
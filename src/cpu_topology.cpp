@@ -0,0 +1,240 @@
+#include "cpu_topology.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#endif
+#include <log.h>
+#include <FileUtil.h>
+
+std::vector<int> CpuTopology::getHostCpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for(int i = 0; i < CPU_SETSIZE; i++) {
+            if(CPU_ISSET(i, &set))
+                cpus.push_back(i);
+        }
+    }
+#endif
+    if(cpus.empty()) {
+        int count = (int)std::max(std::thread::hardware_concurrency(), 1u);
+        for(int i = 0; i < count; i++)
+            cpus.push_back(i);
+    }
+    return cpus;
+}
+
+static int parseNumber(std::string const &str, std::string const &spec) {
+    if(str.empty() || str.size() > 4 || !std::all_of(str.begin(), str.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        throw std::invalid_argument("Invalid cpu topology '" + spec + "', expected a cpu count or a list like 0-3,6");
+    return std::stoi(str);
+}
+
+std::vector<int> CpuTopology::parse(std::string const &spec) {
+    auto host = getHostCpus();
+    if(spec.empty())
+        return host;
+    std::vector<int> cpus;
+    if(spec.find_first_of("-,") == std::string::npos) {
+        int count = parseNumber(spec, spec);
+        if(count <= 0)
+            throw std::invalid_argument("The cpu count has to be at least 1");
+        // More cpus than the host has can only be reported, the game still runs on the host cpus
+        for(int i = 0; i < count; i++)
+            cpus.push_back(i < (int)host.size() ? host[i] : host.back() + i - (int)host.size() + 1);
+        return cpus;
+    }
+    std::stringstream ss(spec);
+    std::string range;
+    while(std::getline(ss, range, ',')) {
+        auto dash = range.find('-');
+        int first = parseNumber(range.substr(0, dash), spec);
+        int last = dash == std::string::npos ? first : parseNumber(range.substr(dash + 1), spec);
+        if(last < first)
+            throw std::invalid_argument("Invalid cpu range '" + range + "'");
+        for(int i = first; i <= last; i++)
+            cpus.push_back(i);
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string CpuTopology::formatList(std::vector<int> const &cpus) {
+    std::string ret;
+    for(size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while(j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            j++;
+        if(!ret.empty())
+            ret += ',';
+        ret += std::to_string(cpus[i]);
+        if(j != i)
+            ret += '-' + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return ret;
+}
+
+bool CpuTopology::applyAffinity(std::vector<int> const &cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(auto cpu : cpus) {
+        if(cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    }
+    if(sched_setaffinity(0, sizeof(set), &set) != 0) {
+        Log::warn("CpuTopology", "Failed to restrict the launcher to cpus %s: %s", formatList(cpus).c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef __linux__
+// The blocks of the host cpuinfo which belong to the cpus, other blocks like the Hardware line on arm are kept
+static bool filterHostCpuInfo(std::vector<int> const &cpus, std::string &out) {
+    std::ifstream in("/proc/cpuinfo", std::ios::binary);
+    if(!in.is_open())
+        return false;
+    std::string line, block;
+    size_t written = 0;
+    auto flush = [&]() {
+        if(block.empty())
+            return;
+        auto pos = block.find("processor\t: ");
+        if(pos == std::string::npos || std::find(cpus.begin(), cpus.end(), atoi(block.c_str() + pos + 12)) != cpus.end()) {
+            out += block + "\n";
+            if(pos != std::string::npos)
+                written++;
+        }
+        block.clear();
+    };
+    while(std::getline(in, line)) {
+        if(line.empty())
+            flush();
+        else
+            block += line + "\n";
+    }
+    flush();
+    // Reported cpus the host doesn't have, fall back to the generated file
+    return written == cpus.size();
+}
+#endif
+
+static std::string generateCpuInfo(std::vector<int> const &cpus) {
+    std::string ret;
+    auto count = std::to_string(cpus.size());
+#if defined(__i386__) || defined(__x86_64__)
+    for(auto cpu : cpus) {
+        auto id = std::to_string(cpu);
+        ret += "processor\t: " + id + R"(
+vendor_id	: GenuineIntel
+cpu family	: 6
+model		: 142
+model name	: Intel(R) Core(TM) i7-8550U CPU @ 1.80GHz
+stepping	: 10
+microcode	: 0xffffffff
+cpu MHz		: 1991.999
+cache size	: 8192 KB
+physical id	: 0
+siblings	: )" + count + R"(
+core id		: )" + id + R"(
+cpu cores	: )" + count + R"(
+apicid		: )" + id + R"(
+initial apicid	: )" + id + R"(
+fpu		: yes
+fpu_exception	: yes
+cpuid level	: 22
+wp		: yes
+flags		: fpu vme de pse tsc msr pae mce cx8 apic sep mtrr pge mca cmov pat pse36 clflush mmx fxsr sse sse2 ss ht syscall nx pdpe1gb rdtscp lm constant_tsc rep_good nopl xtopology cpuid pni pclmulqdq vmx ssse3 fma cx16 pcid sse4_1 sse4_2 movbe popcnt aes xsave avx f16c rdrand hypervisor lahf_lm abm 3dnowprefetch invpcid_single pti ssbd ibrs ibpb stibp tpr_shadow vnmi ept vpid ept_ad fsgsbase bmi1 avx2 smep bmi2 erms invpcid rdseed adx smap clflushopt xsaveopt xsavec xgetbv1 xsaves flush_l1d arch_capabilities
+vmx flags	: vnmi invvpid ept_x_only ept_ad ept_1gb tsc_offset vtpr ept vpid unrestricted_guest ept_mode_based_exec
+bugs		: cpu_meltdown spectre_v1 spectre_v2 spec_store_bypass l1tf mds swapgs itlb_multihit srbds
+bogomips	: 3983.99
+clflush size	: 64
+cache_alignment	: 64
+address sizes	: 39 bits physical, 48 bits virtual
+power management:
+
+)";
+    }
+    ret += "\n";
+#elif defined(__arm__) || defined(__aarch64__)
+    ret += "Processor\t: AArch64 Processor rev 4 (aarch64)\n";
+    for(auto cpu : cpus) {
+        ret += "processor\t: " + std::to_string(cpu) + R"(
+BogoMIPS	: 38.40
+Features	: fp asimd evtstrm aes pmull sha1 sha2 crc32
+CPU implementer	: 0x51
+CPU architecture: 8
+CPU variant	: 0xa
+CPU part	: 0x801
+CPU revision	: 4
+
+)";
+    }
+    ret += "Hardware\t: Qualcomm Technologies, Inc MSM8998\n\n";
+#endif
+    return ret;
+}
+
+static void writeFile(std::string const &path, std::string const &contents) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if(!file.is_open())
+        throw std::runtime_error("Failed to create " + path);
+    file << contents;
+}
+
+void CpuTopology::writeFakeFiles(std::vector<int> const &cpus, std::string const &fakeproc, std::string const &fakesys) {
+    // Fake /proc/cpuinfo
+    // https://github.com/pytorch/cpuinfo depends on this file for linux builds
+    FileUtil::mkdirRecursive(fakeproc);
+    std::string cpuinfo;
+#ifdef __linux__
+    if(!filterHostCpuInfo(cpus, cpuinfo))
+        cpuinfo = generateCpuInfo(cpus);
+#else
+    cpuinfo = generateCpuInfo(cpus);
+#endif
+    writeFile(fakeproc + "/cpuinfo", cpuinfo);
+
+    // cpuinfo for arm64 fails if these are missing...
+    auto fakeCpu = fakesys + "devices/system/cpu/";
+    FileUtil::mkdirRecursive(fakeCpu);
+    auto list = formatList(cpus);
+    writeFile(fakeCpu + "present", list);
+    writeFile(fakeCpu + "possible", list);
+    writeFile(fakeCpu + "online", list);
+#ifdef __linux__
+    // Links of an earlier launch with more cpus would contradict present, possible and online
+    if(auto dir = opendir(fakeCpu.c_str())) {
+        while(auto entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if(name.size() > 3 && name.compare(0, 3, "cpu") == 0 && std::all_of(name.begin() + 3, name.end(), [](char c) { return c >= '0' && c <= '9'; }))
+                unlink((fakeCpu + name).c_str());
+        }
+        closedir(dir);
+    }
+    // Topology and frequency of the reported cpus come from the host
+    for(auto cpu : cpus) {
+        auto name = "cpu" + std::to_string(cpu);
+        auto target = "/sys/devices/system/cpu/" + name;
+        if(access(target.c_str(), F_OK) == 0 && symlink(target.c_str(), (fakeCpu + name).c_str()) != 0)
+            Log::warn("CpuTopology", "Failed to link %s: %s", target.c_str(), strerror(errno));
+    }
+#endif
+    Log::info("CpuTopology", "Reporting %zu cpus to the game: %s", cpus.size(), list.c_str());
+}
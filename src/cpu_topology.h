@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// The cpus the game sees through /proc/cpuinfo and /sys/devices/system/cpu,
+// the cpuinfo library of the game sizes its thread pools from these files
+class CpuTopology {
+public:
+    // The cpus the launcher may run on, from the affinity mask on linux
+    static std::vector<int> getHostCpus();
+
+    // Either a cpu count, which takes the first cpus of the host, or a list like 0-3,6
+    // An empty spec means the host cpus, throws std::invalid_argument for anything else
+    static std::vector<int> parse(std::string const &spec);
+
+    // Same format as the kernel uses, e.g. 0-3,6
+    static std::string formatList(std::vector<int> const &cpus);
+
+    // Restricts the launcher and all threads it starts later to the cpus, only supported on linux
+    static bool applyAffinity(std::vector<int> const &cpus);
+
+    // Writes cpuinfo to fakeproc and devices/system/cpu/{present,possible,online} to fakesys
+    static void writeFakeFiles(std::vector<int> const &cpus, std::string const &fakeproc, std::string const &fakesys);
+};
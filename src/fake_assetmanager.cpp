@@ -1,34 +1,384 @@
 #include <cstdio>
 #include <cstring>
 #include <cerrno>
+#include <algorithm>
 #include <FileUtil.h>
 #include <sys/types.h>
-#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <log.h>
 #include <libc_shim.h>
 #include <android/compat.h>
+#include <android/asset_manager.h>
+#include <zlib.h>
 #include "fake_assetmanager.h"
+#include "asset_prefetch.h"
+#include "asset_stats.h"
+#include "startup_profiler.h"
+#include "startup_benchmark.h"
 
 struct AAsset {
-    std::string buffer;
+    size_t length = 0;
     off64_t offset = 0;
+    AssetStats::Counters *stats = nullptr;
+
+    virtual ~AAsset() = default;
+
+    // Copies count bytes starting at pos, the caller keeps the range inside of length
+    virtual ssize_t readAt(void *buf, size_t count, off64_t pos) = 0;
+
+    virtual const void *getBuffer() = 0;
+
+    virtual bool isAllocated() const = 0;
+};
+
+// Asset with the whole content addressable in memory, shared with the cache and other opens of the same path
+struct ContentAsset : AAsset {
+    std::shared_ptr<const AssetContent> content;
+
+    explicit ContentAsset(std::shared_ptr<const AssetContent> content) : content(std::move(content)) {
+        length = this->content->size;
+    }
+
+    ssize_t readAt(void *buf, size_t count, off64_t pos) override {
+        memcpy(buf, content->data + pos, count);
+        return (ssize_t)count;
+    }
+
+    const void *getBuffer() override {
+        return content->data;
+    }
+
+    bool isAllocated() const override {
+        return content->allocated;
+    }
+};
+
+static ssize_t preadFully(int fd, void *buf, size_t count, off64_t pos) {
+    size_t done = 0;
+    while(done < count) {
+        ssize_t r = pread(fd, (char *)buf + done, count - done, pos + done);
+        if(r < 0 && errno == EINTR)
+            continue;
+        if(r < 0)
+            return -1;
+        if(r == 0)
+            break;
+        done += r;
+    }
+    return (ssize_t)done;
+}
+
+// Asset read on demand through a small rolling window, so memory usage doesn't grow with the asset size
+struct StreamingAsset : AAsset {
+    static constexpr size_t windowCapacity = 64 * 1024;
+
+    int fd;
+    std::unique_ptr<char[]> window;
+    off64_t windowStart = 0;
+    size_t windowSize = 0;
+    void *mapping = nullptr;
+
+    StreamingAsset(int fd, size_t size) : fd(fd), window(new char[windowCapacity]) {
+        length = size;
+    }
+
+    ~StreamingAsset() override {
+        if(mapping)
+            munmap(mapping, length);
+        close(fd);
+    }
+
+    bool fillWindow(off64_t pos) {
+        ssize_t r = preadFully(fd, window.get(), windowCapacity, pos);
+        if(r < 0)
+            return false;
+        windowStart = pos;
+        windowSize = (size_t)r;
+#ifdef POSIX_FADV_WILLNEED
+        // Let the kernel fetch the following window while the game consumes this one
+        if((size_t)(pos + r) < length)
+            posix_fadvise(fd, pos + r, windowCapacity, POSIX_FADV_WILLNEED);
+#endif
+        return true;
+    }
+
+    ssize_t readAt(void *buf, size_t count, off64_t pos) override {
+        if(mapping) {
+            memcpy(buf, (const char *)mapping + pos, count);
+            return (ssize_t)count;
+        }
+        if(count >= windowCapacity) {
+            // Large reads bypass the window instead of copying twice
+            return preadFully(fd, buf, count, pos);
+        }
+        if(pos < windowStart || (size_t)(pos - windowStart) + count > windowSize) {
+            if(!fillWindow(pos))
+                return -1;
+            if(count > windowSize)
+                count = windowSize;
+        }
+        memcpy(buf, window.get() + (pos - windowStart), count);
+        return (ssize_t)count;
+    }
+
+    const void *getBuffer() override {
+        // The game wants the whole content after all, switch to a mapping and drop the window
+        if(!mapping) {
+            void *m = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(m == MAP_FAILED)
+                return nullptr;
+            mapping = m;
+            window.reset();
+            windowSize = 0;
+        }
+        return mapping;
+    }
+
+    bool isAllocated() const override {
+        return false;
+    }
+};
+
+static bool inflateAll(const unsigned char *src, size_t srcSize, std::string &out) {
+    z_stream stream{};
+    if(inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return false;
+    stream.next_in = (Bytef *)src;
+    stream.avail_in = (uInt)srcSize;
+    stream.next_out = (Bytef *)&out[0];
+    stream.avail_out = (uInt)out.size();
+    int r = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    return r == Z_STREAM_END && stream.avail_out == 0;
+}
+
+// Deflated entry of an archive, inflated on demand into a bounded window
+struct InflatingAsset : AAsset {
+    static constexpr size_t windowCapacity = 64 * 1024;
+
+    const unsigned char *compressed;
+    size_t compressedSize;
+    z_stream stream{};
+    std::unique_ptr<char[]> window;
+    off64_t windowStart = 0;
+    size_t windowSize = 0;
+    std::string inflated;
+    bool fullyInflated = false;
+    bool streamInitialized = false;
+
+    InflatingAsset(const unsigned char *compressed, size_t compressedSize, size_t size) : compressed(compressed), compressedSize(compressedSize), window(new char[windowCapacity]) {
+        length = size;
+    }
+
+    ~InflatingAsset() override {
+        if(streamInitialized)
+            inflateEnd(&stream);
+    }
+
+    bool init() {
+        if(inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+            return false;
+        streamInitialized = true;
+        rewindStream();
+        return true;
+    }
+
+    void rewindStream() {
+        inflateReset(&stream);
+        stream.next_in = (Bytef *)compressed;
+        stream.avail_in = (uInt)compressedSize;
+        windowStart = 0;
+        windowSize = 0;
+    }
+
+    // Replaces the window with the next windowCapacity bytes of the inflated stream
+    bool inflateNextWindow() {
+        windowStart += windowSize;
+        stream.next_out = (Bytef *)window.get();
+        stream.avail_out = (uInt)windowCapacity;
+        int r = Z_OK;
+        while(stream.avail_out > 0 && r == Z_OK)
+            r = inflate(&stream, Z_NO_FLUSH);
+        windowSize = windowCapacity - stream.avail_out;
+        return (r == Z_OK || r == Z_STREAM_END) && windowSize > 0;
+    }
+
+    ssize_t readAt(void *buf, size_t count, off64_t pos) override {
+        // Seeking back would inflate from the start again every time, random access reads use the whole content instead
+        if(!fullyInflated && pos < windowStart && !getBuffer())
+            return -1;
+        if(fullyInflated) {
+            memcpy(buf, inflated.data() + pos, count);
+            return (ssize_t)count;
+        }
+        size_t done = 0;
+        while(done < count) {
+            off64_t cur = pos + done;
+            if((size_t)(cur - windowStart) >= windowSize && !inflateNextWindow())
+                return done > 0 ? (ssize_t)done : -1;
+            if(cur < windowStart + (off64_t)windowSize) {
+                size_t n = std::min(count - done, (size_t)(windowStart + windowSize - cur));
+                memcpy((char *)buf + done, window.get() + (cur - windowStart), n);
+                done += n;
+            }
+        }
+        return (ssize_t)done;
+    }
+
+    const void *getBuffer() override {
+        if(!fullyInflated) {
+            inflated.resize(length);
+            if(!inflateAll(compressed, compressedSize, inflated)) {
+                inflated.clear();
+                return nullptr;
+            }
+            fullyInflated = true;
+            window.reset();
+            if(streamInitialized)
+                inflateEnd(&stream);
+            streamInitialized = false;
+        }
+        return inflated.data();
+    }
+
+    bool isAllocated() const override {
+        return true;
+    }
 };
+
+static std::shared_ptr<const AssetContent> loadFile(std::string const &fullPath) {
+    int fd = open(fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return nullptr;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+    if(st.st_size == 0) {
+        close(fd);
+        return std::make_shared<AssetContent>(std::string());
+    }
+    void *mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping != MAP_FAILED)
+        return std::make_shared<AssetContent>(mapping, (size_t)st.st_size);
+
+    Log::warn("AAssetManager", "Failed to map '%s': %s, reading it into memory instead\n", fullPath.c_str(), strerror(errno));
+    std::string content;
+    if(!FileUtil::readFile(fullPath, content))
+        return nullptr;
+    return std::make_shared<AssetContent>(std::move(content));
+}
+
+static std::shared_ptr<const AssetContent> loadArchiveEntry(ZipAssetArchive const &archive, ZipAssetArchive::Entry const &entry) {
+    auto data = archive.getEntryData(entry);
+    if(!data) {
+        Log::error("AAssetManager", "Corrupt local header of '%s' in '%s'\n", entry.name.c_str(), archive.getPath().c_str());
+        return nullptr;
+    }
+    if(entry.method == ZipAssetArchive::STORED)
+        return std::make_shared<AssetContent>((const char *)data, (size_t)entry.uncompressedSize);
+    std::string content(entry.uncompressedSize, '\0');
+    if(!inflateAll(data, (size_t)entry.compressedSize, content)) {
+        Log::error("AAssetManager", "Failed to inflate '%s' in '%s'\n", entry.name.c_str(), archive.getPath().c_str());
+        return nullptr;
+    }
+    return std::make_shared<AssetContent>(std::move(content));
+}
+
+// Large assets opened for streaming bypass the cache and are read through a bounded window
+static AAsset *openStreaming(AssetIndex::Entry const &entry, std::string const &fullPath, int mode) {
+    if(entry.archive) {
+        auto data = entry.archive->getEntryData(*entry.archiveEntry);
+        if(!data)
+            return nullptr;
+        if(entry.archiveEntry->method == ZipAssetArchive::STORED)
+            return new ContentAsset(std::make_shared<AssetContent>((const char *)data, (size_t)entry.size));
+        auto asset = std::unique_ptr<InflatingAsset>(new InflatingAsset(data, (size_t)entry.archiveEntry->compressedSize, (size_t)entry.size));
+        if(!asset->init()) {
+            Log::error("AAssetManager", "Failed to initialize inflating '%s' in '%s'\n", entry.archiveEntry->name.c_str(), entry.archive->getPath().c_str());
+            return nullptr;
+        }
+        return asset.release();
+    }
+    int fd = open(fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return nullptr;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, mode == AASSET_MODE_STREAMING ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+#endif
+    return new StreamingAsset(fd, (size_t)st.st_size);
+}
+
 struct AAssetDir {
-    DIR *dir;
-    dirent *ent;
+    AssetIndex::Entry const *entry;
+    size_t position = 0;
     std::string dirname;
-    std::string currentFileName;
 };
 
-FakeAssetManager::FakeAssetManager(std::string rootDir) {
+FakeAssetManager::FakeAssetManager(std::string rootDir, std::string archivePath, std::vector<std::string> const &overlays) {
     if(!rootDir.empty() && *rootDir.rbegin() != '/')
         rootDir += '/';
     this->rootDir = std::move(rootDir);
+
+    auto addLayer = [this](std::string path, bool archive) {
+        Layer layer;
+        if(archive) {
+            try {
+                layer.archive = std::make_unique<ZipAssetArchive>(std::move(path));
+            } catch(const std::exception &ex) {
+                Log::error("AAssetManager", "Failed to open the assets archive: %s", ex.what());
+                return;
+            }
+        } else {
+            if(!path.empty() && *path.rbegin() != '/')
+                path += '/';
+            layer.dir = std::move(path);
+        }
+        layers.push_back(std::move(layer));
+    };
+    for(auto &&overlay : overlays) {
+        struct stat st;
+        if(stat(overlay.c_str(), &st) != 0) {
+            Log::warn("AAssetManager", "Asset overlay '%s' does not exist", overlay.c_str());
+            continue;
+        }
+        addLayer(overlay, !S_ISDIR(st.st_mode));
+    }
+    // Files extracted to rootDir take precedence over the archive
+    addLayer(this->rootDir, false);
+    if(!archivePath.empty())
+        addLayer(std::move(archivePath), true);
+}
+
+AssetIndex const &FakeAssetManager::getIndex() {
+    std::call_once(indexBuilt, [this]() {
+        StartupProfiler::Scope scope("AssetIndex build");
+        for(auto &&layer : layers) {
+            if(layer.archive) {
+                index.addArchive(*layer.archive);
+            } else if(!index.addDirectory(layer.dir)) {
+                Log::warn("AAssetManager", "Assets directory '%s' does not exist", layer.dir.c_str());
+            }
+        }
+        Log::info("AAssetManager", "Indexed %zu assets from %zu layers", index.size(), layers.size());
+    });
+    return index;
 }
 
 namespace fake_assetmanager {
 
 AAsset *AAssetManager_open(FakeAssetManager *amgr, const char *filename, int mode) {
+    AssetStats::Timer timer;
     std::string fullPath;
     if(filename == NULL) {
 #ifndef NDEBUG
@@ -36,24 +386,46 @@ AAsset *AAssetManager_open(FakeAssetManager *amgr, const char *filename, int mod
 #endif
         return nullptr;
     }
+    if(StartupBenchmark::isActive())
+        StartupBenchmark::onAssetOpened();
 
-    if(filename[0] != '/') {
-        fullPath = amgr->rootDir + filename;
-    } else {
+    if(filename[0] == '/') {
         // Ignore full paths, the game tries to open user data files with the AAssetManager
         return nullptr;
     }
+    auto path = AssetIndex::normalizePath(filename);
+    auto entry = amgr->getIndex().find(path);
+    if(!entry || entry->directory) {
+#ifndef NDEBUG
+        Log::trace("AAssetManager", "Opening file '%s' failed, not in the assets index\n", filename);
+#endif
+        AssetStats::recordFailedOpen();
+        return nullptr;
+    }
+    AssetPrefetch::recordOpen(path);
+    if(!entry->archive)
+        fullPath = *entry->rootDir + path;
 
 #ifndef NDEBUG
-    Log::trace("AAssetManager", "Opening file '%s' as '%s'\n", filename, fullPath.c_str());
+    Log::trace("AAssetManager", "Opening file '%s' from '%s'\n", filename, entry->archive ? entry->archive->getPath().c_str() : fullPath.c_str());
 #endif
 
-    std::string content;
-    if(!FileUtil::readFile(fullPath, content))
+    AAsset *ret;
+    if((mode == AASSET_MODE_STREAMING || mode == AASSET_MODE_RANDOM) && entry->size > StreamingAsset::windowCapacity) {
+        ret = openStreaming(*entry, fullPath, mode);
+    } else {
+        auto content = amgr->cache.getOrLoad(path, [&]() {
+            return entry->archive ? loadArchiveEntry(*entry->archive, *entry->archiveEntry) : loadFile(fullPath);
+        });
+        ret = content ? new ContentAsset(std::move(content)) : nullptr;
+    }
+    if(!ret) {
+        AssetStats::recordFailedOpen();
         return nullptr;
-
-    auto ret = new AAsset;
-    ret->buffer = content;
+    }
+    ret->stats = AssetStats::get(path);
+    ret->stats->opens.fetch_add(1, std::memory_order_relaxed);
+    ret->stats->openNanos.fetch_add(timer.elapsedNanos(), std::memory_order_relaxed);
     return ret;
 }
 
@@ -65,25 +437,21 @@ AAssetDir *AAssetManager_openDir(FakeAssetManager *amgr, const char *dirname) {
         return nullptr;
     }
 
-    std::string fullPath;
-    if(dirname[0] != '/') {
-        fullPath = amgr->rootDir + dirname;
-    } else {
+    if(dirname[0] == '/') {
         // Ignore full paths, the game tries to open user data files with the AAssetManager
         return nullptr;
     }
+    auto entry = amgr->getIndex().find(AssetIndex::normalizePath(dirname));
 
 #ifndef NDEBUG
-    Log::trace("AAssetManager", "Opening directory '%s' as '%s'\n", dirname, fullPath.c_str());
+    Log::trace("AAssetManager", "Opening directory '%s' %s\n", dirname, entry && entry->directory ? "succeeded" : "failed");
 #endif
 
-    DIR *d = opendir(fullPath.c_str());
-    if(!d)
+    if(!entry || !entry->directory)
         return nullptr;
 
     auto ret = new AAssetDir;
-    ret->dir = d;
-    ret->ent = nullptr;
+    ret->entry = entry;
     ret->dirname = dirname;
     return ret;
 }
@@ -93,28 +461,35 @@ void AAsset_close(AAsset *asset) {
 }
 
 int AAsset_isAllocated(AAsset *asset) {
-    return true;
+    return asset->isAllocated();
 }
 
 ssize_t AAsset_read(AAsset *asset, void *buf, size_t count) {
-    if(asset->offset > asset->buffer.size()) {
+    if((size_t)asset->offset > asset->length) {
         return 0;
     }
-    size_t max_len = asset->buffer.size() - asset->offset;
+    size_t max_len = asset->length - asset->offset;
     if(count > max_len) {
         count = max_len;
     }
     if(count == 0) {
         return 0;
     }
-    memcpy(buf, &asset->buffer[asset->offset], count);
-    asset->offset += count;
-    return (ssize_t)count;
+    AssetStats::Timer timer;
+    ssize_t r = asset->readAt(buf, count, asset->offset);
+    if(r > 0) {
+        asset->offset += r;
+        asset->stats->bytesRead.fetch_add((uint64_t)r, std::memory_order_relaxed);
+    }
+    asset->stats->reads.fetch_add(1, std::memory_order_relaxed);
+    asset->stats->readNanos.fetch_add(timer.elapsedNanos(), std::memory_order_relaxed);
+    return r;
 }
 
 off64_t AAsset_seek64(AAsset *asset, off64_t offset, int whence) {
+    asset->stats->seeks.fetch_add(1, std::memory_order_relaxed);
     off64_t cur_pos = asset->offset;
-    off64_t max_pos = asset->buffer.size();
+    off64_t max_pos = asset->length;
     off64_t new_offset;
 
     if(whence == SEEK_SET) {
@@ -123,6 +498,8 @@ off64_t AAsset_seek64(AAsset *asset, off64_t offset, int whence) {
         new_offset = cur_pos + offset;
     } else if(whence == SEEK_END) {
         new_offset = max_pos + offset;
+    } else {
+        return -1;
     }
     if(new_offset < 0 || new_offset > max_pos)
         return -1;
@@ -135,50 +512,42 @@ off_t AAsset_seek(AAsset *asset, off_t offset, int whence) {
 }
 
 off64_t AAsset_getLength64(AAsset *asset) {
-    return (off64_t)asset->buffer.size();
+    return (off64_t)asset->length;
 }
 
 off_t AAsset_getLength(AAsset *asset) {
-    return (off_t)asset->buffer.size();
+    return (off_t)asset->length;
 }
 
 off64_t AAsset_getRemainingLength64(AAsset *asset) {
-    return (off64_t)(asset->buffer.size() - asset->offset);
+    return (off64_t)(asset->length - asset->offset);
 }
 
 off_t AAsset_getRemainingLength(AAsset *asset) {
-    return (off_t)(asset->buffer.size() - asset->offset);
+    return (off_t)(asset->length - asset->offset);
 }
 
 const void *AAsset_getBuffer(AAsset *asset) {
-    return asset->buffer.c_str();
+    asset->stats->bufferUsed.store(true, std::memory_order_relaxed);
+    return asset->getBuffer();
 }
 
 void AAssetDir_close(AAssetDir *assetDir) {
-    if(assetDir)
-        closedir(assetDir->dir);
     delete assetDir;
 }
 
 void AAssetDir_rewind(AAssetDir *assetDir) {
-    rewinddir(assetDir->dir);
+    assetDir->position = 0;
 }
 
 const char *AAssetDir_getNextFileName(AAssetDir *assetDir) {
-    if(!assetDir)
-        return nullptr;
-    assetDir->ent = readdir(assetDir->dir);
-    if(!assetDir->ent)
+    if(!assetDir || assetDir->position >= assetDir->entry->children.size())
         return nullptr;
-    std::string cname = assetDir->ent->d_name;
-    if(cname == "." || cname == "..") {
-        return AAssetDir_getNextFileName(assetDir);
-    }
-    assetDir->currentFileName = cname;
+    auto &name = assetDir->entry->children[assetDir->position++];
 #ifndef NDEBUG
-    Log::trace("AAssetDir", "'%s' getNextFileName '%s'\n", assetDir->dirname.data(), assetDir->currentFileName.data());
+    Log::trace("AAssetDir", "'%s' getNextFileName '%s'\n", assetDir->dirname.data(), name.data());
 #endif
-    return assetDir->currentFileName.data();
+    return name.data();
 }
 
 }  // namespace fake_assetmanager
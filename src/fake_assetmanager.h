@@ -4,17 +4,39 @@
 #include <memory>
 #include <unordered_map>
 #include <utility>
+#include <mutex>
+#include <vector>
+#include "asset_cache.h"
+#include "asset_index.h"
+#include "zip_asset_archive.h"
 
 struct AAssetManager;
 
 struct FakeAssetManager {
     std::string rootDir;
+    AssetCache cache;
 
-    FakeAssetManager(std::string rootDir);
+    // archivePath optionally names an apk or zip to serve the assets missing from rootDir.
+    // overlays are directories or archives which shadow rootDir, the first one has the highest priority.
+    FakeAssetManager(std::string rootDir, std::string archivePath = std::string(), std::vector<std::string> const &overlays = {});
+
+    // Merges all layers into one index on first use, the assets don't change while the game runs
+    AssetIndex const &getIndex();
 
     static void initHybrisHooks(std::unordered_map<std::string, void *> &syms);
 
     explicit operator AAssetManager *() const {
         return (AAssetManager *)this;
     }
+
+private:
+    struct Layer {
+        std::string dir;
+        std::unique_ptr<ZipAssetArchive> archive;
+    };
+
+    // Ordered by priority, the index entries point into them so this never changes after construction
+    std::vector<Layer> layers;
+    AssetIndex index;
+    std::once_flag indexBuilt;
 };
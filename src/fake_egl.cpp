@@ -2,6 +2,8 @@
 #include "gl_core_patch.h"
 #include "settings.h"
 #include "imgui_ui.h"
+#include "startup_profiler.h"
+#include "startup_benchmark.h"
 #include <map>
 
 #define __ANDROID__
@@ -112,6 +114,10 @@ EGLBoolean eglSwapBuffers(EGLDisplay display, EGLSurface surface) {
     ImGuiUIDrawFrame((GameWindow*)surface);
 #endif
     ((GameWindow *)surface)->swapBuffers();
+    if(StartupProfiler::isEnabled())
+        StartupProfiler::onFirstFrame();
+    if(StartupBenchmark::isActive())
+        StartupBenchmark::onFrame();
     return EGL_TRUE;
 }
 
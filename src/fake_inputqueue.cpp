@@ -1,27 +1,72 @@
 #include "fake_inputqueue.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <ctime>
+#include <cstring>
 #include <stdexcept>
+#include <log.h>
 #include "armhfrewrite.h"
 
 static float _AMotionEvent_getX(const AInputEvent *event, size_t pointerIndex) {
-    return ((const FakeMotionEvent *)(const void *)event)->x;
+    return ((const FakeMotionEvent *)(const void *)event)->pointers[pointerIndex].x;
 }
 
 static float _AMotionEvent_getY(const AInputEvent *event, size_t pointerIndex) {
-    return ((const FakeMotionEvent *)(const void *)event)->y;
+    return ((const FakeMotionEvent *)(const void *)event)->pointers[pointerIndex].y;
+}
+
+static float _AMotionEvent_getHistoricalX(const AInputEvent *event, size_t pointerIndex, size_t historyIndex) {
+    return ((const FakeMotionEvent *)(const void *)event)->history[historyIndex].x[pointerIndex];
+}
+
+static float _AMotionEvent_getHistoricalY(const AInputEvent *event, size_t pointerIndex, size_t historyIndex) {
+    return ((const FakeMotionEvent *)(const void *)event)->history[historyIndex].y[pointerIndex];
 }
 
 static float _AMotionEvent_getAxisValue(const AInputEvent *event, int32_t axis, size_t pointerIndex) {
-    auto axisFunction = ((const FakeMotionEvent *)(const void *)event)->axisFunction;
-    if(axisFunction) {
-        return axisFunction(axis);
-    }
+    auto motionEvent = (const FakeMotionEvent *)(const void *)event;
+    if(motionEvent->hasAxisValues)
+        return axis >= 0 && axis < FakeMotionEvent::axisCount ? motionEvent->axisValues[axis] : 0.f;
     int32_t dy = ((const FakeMotionEvent *)(const void *)event)->dy;
     if(dy)
         return dy;
     return 0;
 }
 
+static float _AMotionEvent_getHistoricalAxisValue(const AInputEvent *event, int32_t axis, size_t pointerIndex, size_t historyIndex) {
+    if(axis == AMOTION_EVENT_AXIS_X)
+        return _AMotionEvent_getHistoricalX(event, pointerIndex, historyIndex);
+    if(axis == AMOTION_EVENT_AXIS_Y)
+        return _AMotionEvent_getHistoricalY(event, pointerIndex, historyIndex);
+    // Only positions are coalesced, other axes are the same in every sample
+    return _AMotionEvent_getAxisValue(event, axis, pointerIndex);
+}
+
+static int64_t getMonotonicNanos() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Moves of the same pointers which only differ in positions, time or axis values, relative moves are deltas
+static bool canCoalesce(FakeMotionEvent const &a, FakeMotionEvent const &b) {
+    if(!(a.action == AMOTION_EVENT_ACTION_MOVE || a.action == AMOTION_EVENT_ACTION_HOVER_MOVE) || a.source == AINPUT_SOURCE_MOUSE_RELATIVE || a.hasAxisValues != b.hasAxisValues ||
+       a.action != b.action || a.source != b.source || a.deviceId != b.deviceId || a.btn != b.btn || a.dy != b.dy || a.pointerCount != b.pointerCount)
+        return false;
+    for(size_t i = 0; i < a.pointerCount; i++) {
+        if(a.pointers[i].id != b.pointers[i].id)
+            return false;
+    }
+    return true;
+}
+
 
 void FakeInputQueue::initHybrisHooks(std::unordered_map<std::string, void *> &syms) {
     syms["AInputQueue_getEvent"] = (void *)+[](AInputQueue *queue, AInputEvent **outEvent) {
@@ -58,19 +103,28 @@ void FakeInputQueue::initHybrisHooks(std::unordered_map<std::string, void *> &sy
         return ((const FakeMotionEvent *)(const void *)event)->action;
     };
     syms["AMotionEvent_getPointerCount"] = (void *)+[](const AInputEvent *event) {
-        return 1;
+        return ((const FakeMotionEvent *)(const void *)event)->pointerCount;
     };
     syms["AMotionEvent_getButtonState"] = (void *)+[](const AInputEvent *event) {
         if(((const FakeMotionEvent *)(const void *)event)->btn)
             return ((const FakeMotionEvent *)(const void *)event)->btn;
         return 0;
     };
-    syms["AMotionEvent_getPointerId"] = (void *)+[](const AInputEvent *event) {
-        return ((const FakeMotionEvent *)(const void *)event)->pointerId;
+    syms["AMotionEvent_getPointerId"] = (void *)+[](const AInputEvent *event, size_t pointerIndex) {
+        return ((const FakeMotionEvent *)(const void *)event)->pointers[pointerIndex].id;
     };
     
     syms["AMotionEvent_getHistorySize"] = (void *)+[](const AInputEvent *event) {
-        return 0;
+        return ((const FakeMotionEvent *)(const void *)event)->historySize;
+    };
+    syms["AMotionEvent_getEventTime"] = (void *)+[](const AInputEvent *event) {
+        return ((const FakeInputEvent *)(const void *)event)->eventTime;
+    };
+    syms["AKeyEvent_getEventTime"] = (void *)+[](const AInputEvent *event) {
+        return ((const FakeInputEvent *)(const void *)event)->eventTime;
+    };
+    syms["AMotionEvent_getHistoricalEventTime"] = (void *)+[](const AInputEvent *event, size_t historyIndex) {
+        return ((const FakeMotionEvent *)(const void *)event)->history[historyIndex].eventTime;
     };
 
     syms["AMotionEvent_getX"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getX));
@@ -78,36 +132,228 @@ void FakeInputQueue::initHybrisHooks(std::unordered_map<std::string, void *> &sy
     syms["AMotionEvent_getRawX"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getX));
     syms["AMotionEvent_getRawY"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getY));
     syms["AMotionEvent_getAxisValue"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getAxisValue));
+    syms["AMotionEvent_getHistoricalX"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getHistoricalX));
+    syms["AMotionEvent_getHistoricalY"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getHistoricalY));
+    syms["AMotionEvent_getHistoricalRawX"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getHistoricalX));
+    syms["AMotionEvent_getHistoricalRawY"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getHistoricalY));
+    syms["AMotionEvent_getHistoricalAxisValue"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getHistoricalAxisValue));
 }
 
-int FakeInputQueue::getEvent(FakeInputEvent **event) {
-    if(!keyEvents.empty()) {
-        *event = &keyEvents.front();
-        return 0;
+FakeInputQueue::FakeInputQueue() : entries(new Entry[capacity]) {
+#ifdef __linux__
+    readFd = writeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(readFd < 0)
+        throw std::runtime_error(std::string("Failed to create the input queue eventfd: ") + strerror(errno));
+#else
+    int fds[2];
+    if(pipe(fds) != 0)
+        throw std::runtime_error(std::string("Failed to create the input queue pipe: ") + strerror(errno));
+    for(int fd : fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
     }
-    if(!motionEvents.empty()) {
-        *event = &motionEvents.front();
-        return 0;
+    readFd = fds[0];
+    writeFd = fds[1];
+#endif
+}
+
+FakeInputQueue::~FakeInputQueue() {
+    if(writeFd != readFd)
+        close(writeFd);
+    close(readFd);
+}
+
+void FakeInputQueue::signal() {
+    // Only the first event after the consumer saw the ring empty needs a write
+    if(signaled.exchange(true))
+        return;
+#ifdef __linux__
+    uint64_t value = 1;
+#else
+    char value = 1;
+#endif
+    if(write(writeFd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        Log::error("FakeInputQueue", "Failed to signal the looper: %s", strerror(errno));
+}
+
+bool FakeInputQueue::clearSignalIfEmpty() {
+    if(head.load(std::memory_order_relaxed) != tail.load(std::memory_order_acquire))
+        return false;
+    if(!signaled.load())
+        return true;
+    char buf[16];
+    while(read(readFd, buf, sizeof(buf)) > 0) {
+    }
+    signaled.store(false);
+    // An event added before the signal was cleared wouldn't signal again
+    if(head.load(std::memory_order_relaxed) != tail.load(std::memory_order_acquire)) {
+        signal();
+        return false;
+    }
+    return true;
+}
+
+int FakeInputQueue::getEvent(FakeInputEvent **event) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if(h == tail.load(std::memory_order_acquire)) {
+        clearSignalIfEmpty();
+        return -1;
     }
-    return -1;
+    auto &entry = entries[h % capacity];
+    if(entry.type == AINPUT_EVENT_TYPE_KEY)
+        *event = &entry.key;
+    else
+        *event = &entry.motion;
+    return 0;
 }
 
 void FakeInputQueue::finishEvent(FakeInputEvent *event) {
-    if(!keyEvents.empty() && &keyEvents.front() == event) {
-        keyEvents.pop_front();
-        return;
+    size_t h = head.load(std::memory_order_relaxed);
+    auto &entry = entries[h % capacity];
+    if(h == tail.load(std::memory_order_acquire) || (event != &entry.key && event != &entry.motion))
+        throw std::runtime_error("finishEvent: the event is not the event on the front of queue");
+    head.store(h + 1, std::memory_order_release);
+}
+
+FakeInputQueue::Entry *FakeInputQueue::beginAdd() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(t - head.load(std::memory_order_acquire) >= capacity) {
+        if(!overflowLogged) {
+            Log::warn("FakeInputQueue", "The input queue is full, dropping events");
+            overflowLogged = true;
+        }
+        return nullptr;
     }
-    if(!motionEvents.empty() && &motionEvents.front() == event) {
-        motionEvents.pop_front();
+    overflowLogged = false;
+    return &entries[t % capacity];
+}
+
+void FakeInputQueue::endAdd() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    signal();
+}
+
+bool FakeInputQueue::isProducerThread() {
+    if(std::this_thread::get_id() == ownerThread)
+        return true;
+    // A second producer would race on tail and the pending move
+    assert(false && "FakeInputQueue: events must be added by the thread owning the queue");
+    if(!wrongThreadLogged.exchange(true))
+        Log::error("FakeInputQueue", "Events were added from a thread not owning the input queue, dropping them");
+    return false;
+}
+
+void FakeInputQueue::addEvent(FakeKeyEvent const &event) {
+    if(!isProducerThread())
+        return;
+    publishPendingMove();
+    auto entry = beginAdd();
+    if(!entry)
+        return;
+    entry->type = AINPUT_EVENT_TYPE_KEY;
+    entry->key = event;
+    entry->key.eventTime = getMonotonicNanos();
+    endAdd();
+}
+
+void FakeInputQueue::addEvent(FakeMotionEvent const &event) {
+    if(!isProducerThread())
         return;
+    int64_t eventTime = getMonotonicNanos();
+    if(hasPendingMove) {
+        auto &pending = entries[tail.load(std::memory_order_relaxed) % capacity].motion;
+        if(canCoalesce(pending, event) && pending.hasAxisValues) {
+            // Gamepads report the latest state of all axes, no history needed
+            memcpy(pending.axisValues, event.axisValues, sizeof(pending.axisValues));
+            pending.eventTime = eventTime;
+            return;
+        }
+        if(canCoalesce(pending, event) && pending.historySize < FakeMotionEvent::maxHistorySize) {
+            auto &sample = pending.history[pending.historySize++];
+            for(size_t i = 0; i < pending.pointerCount; i++) {
+                sample.x[i] = pending.pointers[i].x;
+                sample.y[i] = pending.pointers[i].y;
+                pending.pointers[i] = event.pointers[i];
+            }
+            sample.eventTime = pending.eventTime;
+            pending.eventTime = eventTime;
+            return;
+        }
+        publishPendingMove();
     }
-    throw std::runtime_error("finishEvent: the event is not the event on the front of queue");
+    auto entry = beginAdd();
+    if(!entry)
+        return;
+    entry->type = AINPUT_EVENT_TYPE_MOTION;
+    entry->motion = event;
+    entry->motion.eventTime = eventTime;
+    entry->motion.historySize = 0;
+    if(canCoalesce(entry->motion, entry->motion))
+        hasPendingMove = true;
+    else
+        endAdd();
+}
+
+void FakeInputQueue::publishPendingMove() {
+    if(!hasPendingMove)
+        return;
+    hasPendingMove = false;
+    endAdd();
+}
+
+void FakeInputQueue::flush() {
+    if(!isProducerThread())
+        return;
+    publishPendingMove();
+}
+
+FakeTouchPointers::FakeTouchPointers() {
+    pointers.reserve(FakeMotionEvent::maxPointers);
+}
+
+std::vector<FakeMotionEvent::Pointer>::iterator FakeTouchPointers::find(int32_t id) {
+    return std::find_if(pointers.begin(), pointers.end(), [id](FakeMotionEvent::Pointer const &p) { return p.id == id; });
+}
+
+void FakeTouchPointers::makeEvent(int32_t action, FakeMotionEvent &event) const {
+    event = FakeMotionEvent(AINPUT_SOURCE_TOUCHSCREEN, action, 0, 0.f, 0.f);
+    event.pointerCount = pointers.size();
+    std::copy(pointers.begin(), pointers.end(), event.pointers);
+}
+
+bool FakeTouchPointers::down(int32_t id, float x, float y, FakeMotionEvent &event) {
+    if(pointers.size() >= FakeMotionEvent::maxPointers)
+        return false;
+    pointers.push_back({id, x, y});
+    if(pointers.size() == 1)
+        makeEvent(AMOTION_EVENT_ACTION_DOWN, event);
+    else
+        makeEvent(AMOTION_EVENT_ACTION_POINTER_DOWN | (int32_t)((pointers.size() - 1) << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT), event);
+    return true;
 }
 
-void FakeInputQueue::addEvent(FakeKeyEvent event) {
-    keyEvents.push_back(event);
+bool FakeTouchPointers::move(int32_t id, float x, float y, FakeMotionEvent &event) {
+    auto pointer = find(id);
+    if(pointer == pointers.end())
+        return false;
+    pointer->x = x;
+    pointer->y = y;
+    // The input queue merges the moves of one window event loop iteration
+    makeEvent(AMOTION_EVENT_ACTION_MOVE, event);
+    return true;
 }
 
-void FakeInputQueue::addEvent(FakeMotionEvent event) {
-    motionEvents.push_back(std::move(event));
+bool FakeTouchPointers::up(int32_t id, float x, float y, FakeMotionEvent &event) {
+    auto pointer = find(id);
+    if(pointer == pointers.end())
+        return false;
+    pointer->x = x;
+    pointer->y = y;
+    size_t index = pointer - pointers.begin();
+    if(pointers.size() == 1)
+        makeEvent(AMOTION_EVENT_ACTION_UP, event);
+    else
+        makeEvent(AMOTION_EVENT_ACTION_POINTER_UP | (int32_t)(index << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT), event);
+    pointers.erase(pointer);
+    return true;
 }
@@ -1,14 +1,18 @@
 #pragma once
 
 #include <android/input.h>
-#include <deque>
-#include <functional>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 struct FakeInputEvent {
     int32_t source, type;
     int32_t deviceId = 0;
+    // CLOCK_MONOTONIC nanoseconds, set by FakeInputQueue::addEvent
+    int64_t eventTime = 0;
 
     FakeInputEvent(int32_t source, int32_t type, int32_t deviceId = 0) : source(source), type(type), deviceId(deviceId) {}
 };
@@ -23,43 +27,125 @@ struct FakeKeyEvent : FakeInputEvent {
 
 struct FakeMotionEvent : FakeInputEvent {
     int32_t action;
-    int32_t pointerId;
-    float x, y;
-    std::function<float(int32_t axis)> axisFunction;
     int32_t btn = 0, dy = 0;
 
-    FakeMotionEvent(int32_t source, int32_t action, int32_t pointerId, float x, float y) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION), action(action), pointerId(pointerId), x(x), y(y) {}
+    static constexpr size_t maxPointers = 10;
+    struct Pointer {
+        int32_t id;
+        float x, y;
+    };
+    size_t pointerCount = 1;
+    Pointer pointers[maxPointers];
+
+    // Snapshot of every axis for gamepad events, indexed by AMOTION_EVENT_AXIS_*
+    static constexpr int32_t axisCount = AMOTION_EVENT_AXIS_GENERIC_16 + 1;
+    bool hasAxisValues = false;
+    float axisValues[axisCount];
+
+    // Older samples of a coalesced move, oldest first
+    static constexpr size_t maxHistorySize = 32;
+    struct HistorySample {
+        float x[maxPointers], y[maxPointers];
+        int64_t eventTime;
+    };
+    size_t historySize = 0;
+    HistorySample history[maxHistorySize];
+
+    FakeMotionEvent(int32_t source, int32_t action, int32_t pointerId, float x, float y) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION), action(action) {
+        pointers[0] = {pointerId, x, y};
+    }
 
-    FakeMotionEvent(int32_t source, int32_t action, int32_t pointerId, float x, float y, int32_t btn, int32_t dy) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION), action(action), pointerId(pointerId), x(x), y(y), btn(btn), dy(dy) {}
+    FakeMotionEvent(int32_t source, int32_t action, int32_t pointerId, float x, float y, int32_t btn, int32_t dy) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION), action(action), btn(btn), dy(dy) {
+        pointers[0] = {pointerId, x, y};
+    }
 
-    FakeMotionEvent(int32_t source, int32_t deviceId, int32_t action, int32_t pointerId, float x, float y, std::function<float(int32_t axis)> axisFunction) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION, deviceId), action(action), pointerId(pointerId), x(x), y(y), axisFunction(std::move(axisFunction)) {}
+    // All axis values start at 0
+    FakeMotionEvent(int32_t source, int32_t deviceId, int32_t action, int32_t pointerId, float x, float y) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION, deviceId), action(action), hasAxisValues(true), axisValues() {
+        pointers[0] = {pointerId, x, y};
+    }
 
     FakeMotionEvent() : FakeMotionEvent(0, 0, 0, 0, 0) {}
 };
 
+// Touch pointers which are down, in the order they went down, which is their pointer index.
+// Every event reports all of them, POINTER_DOWN and POINTER_UP carry the index of the pointer which changed
+class FakeTouchPointers {
+private:
+    std::vector<FakeMotionEvent::Pointer> pointers;
+
+    std::vector<FakeMotionEvent::Pointer>::iterator find(int32_t id);
+
+    void makeEvent(int32_t action, FakeMotionEvent &event) const;
+
+public:
+    FakeTouchPointers();
+
+    bool contains(int32_t id) { return find(id) != pointers.end(); }
+
+    size_t size() const { return pointers.size(); }
+
+    // Each returns false without an event if maxPointers are down already, or the pointer isn't down
+    bool down(int32_t id, float x, float y, FakeMotionEvent &event);
+
+    bool move(int32_t id, float x, float y, FakeMotionEvent &event);
+
+    bool up(int32_t id, float x, float y, FakeMotionEvent &event);
+};
+
+// Single producer, single consumer (the game) ring of events in arrival order.
+// getEvent returns the oldest event, which stays in its slot until finishEvent.
+// The only producer is the thread owning the queue, that is the looper thread which pumps the window events
+// and publishes the merged moves with flush() afterwards, events added from other threads are dropped
 class FakeInputQueue {
 private:
-    std::deque<FakeKeyEvent> keyEvents;
-    std::deque<FakeMotionEvent> motionEvents;
+    static constexpr size_t capacity = 1024;
+
+    struct Entry {
+        int32_t type;
+        FakeKeyEvent key;
+        FakeMotionEvent motion;
+    };
+    std::unique_ptr<Entry[]> entries;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic_bool signaled{false};
+    bool overflowLogged = false;
+    // The slot at tail holds a move which later moves of the same pointers or gamepad are merged into, until flush()
+    bool hasPendingMove = false;
+    std::thread::id ownerThread = std::this_thread::get_id();
+    std::atomic_bool wrongThreadLogged{false};
+    // eventfd on linux, both ends of a pipe elsewhere, readable while events are queued
+    int readFd = -1, writeFd = -1;
+
+    Entry *beginAdd();
+    void endAdd();
+    void signal();
+    void publishPendingMove();
+    bool isProducerThread();
+    bool clearSignalIfEmpty();
 
 public:
     static void initHybrisHooks(std::unordered_map<std::string, void *> &syms);
 
-    FakeInputQueue() {
-        // Should avoid a crash caused by a lot of events from gamepad's analog sticks
-        motionEvents.resize(100);
-        motionEvents.clear();
-        keyEvents.resize(100);
-        keyEvents.clear();
-    }
+    FakeInputQueue();
+    FakeInputQueue(FakeInputQueue const &) = delete;
+    ~FakeInputQueue();
 
-    bool hasEvents() const { return !keyEvents.empty() || !motionEvents.empty(); }
+    int getFd() const { return readFd; }
+
+    // Consumer side
+    bool hasEvents() { return !clearSignalIfEmpty(); }
 
     int getEvent(FakeInputEvent **event);
 
     void finishEvent(FakeInputEvent *event);
 
-    void addEvent(FakeKeyEvent event);
+    // Producer side, only called by the owner thread. Events are copied into the preallocated slots, which are reused once finished.
+    // Drops the event if the game stopped consuming and the ring is full
+    void addEvent(FakeKeyEvent const &event);
+
+    void addEvent(FakeMotionEvent const &event);
 
-    void addEvent(FakeMotionEvent event);
+    // Makes a pending coalesced move visible to the game, called by the owner thread after each window event loop iteration
+    void flush();
 };
@@ -5,8 +5,19 @@
 #include "gl_core_patch.h"
 #include "core_patches.h"
 #include "fake_egl.h"
+#include "settings.h"
 
 #include <sys/poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <vector>
 
 #include <game_window_manager.h>
 #include <log.h>
@@ -16,6 +27,8 @@
 
 JniSupport *FakeLooper::jniSupport;
 thread_local std::unique_ptr<FakeLooper> FakeLooper::currentLooper;
+std::mutex FakeLooper::attachedLoopersMutex;
+std::unordered_map<AInputQueue *, FakeLooper *> FakeLooper::attachedLoopers;
 
 void FakeLooper::initWindow() {
     if(!currentLooper) {
@@ -36,14 +49,43 @@ void FakeLooper::initHybrisHooks(std::unordered_map<std::string, void *> &syms)
         currentLooper->prepare();
         return (ALooper *)(void *)currentLooper.get();
     };
+    syms["ALooper_forThread"] = (void *)+[]() {
+        return (ALooper *)(void *)currentLooper.get();
+    };
+    // The loopers live as long as their thread
+    syms["ALooper_acquire"] = (void *)+[](ALooper *looper) {};
+    syms["ALooper_release"] = (void *)+[](ALooper *looper) {};
     syms["ALooper_addFd"] = (void *)+[](ALooper *looper, int fd, int ident, int events, ALooper_callbackFunc callback, void *data) {
         return ((FakeLooper *)(void *)looper)->addFd(fd, ident, events, callback, data);
     };
+    syms["ALooper_removeFd"] = (void *)+[](ALooper *looper, int fd) {
+        return ((FakeLooper *)(void *)looper)->removeFd(fd);
+    };
+    syms["ALooper_wake"] = (void *)+[](ALooper *looper) {
+        ((FakeLooper *)(void *)looper)->wake();
+    };
+    syms["ALooper_pollOnce"] = (void *)+[](int timeoutMillis, int *outFd, int *outEvents, void **outData) {
+        return currentLooper->pollOnce(timeoutMillis, outFd, outEvents, outData);
+    };
     syms["ALooper_pollAll"] = (void *)+[](int timeoutMillis, int *outFd, int *outEvents, void **outData) {
         return currentLooper->pollAll(timeoutMillis, outFd, outEvents, outData);
     };
     syms["AInputQueue_attachLooper"] = (void *)+[](AInputQueue *queue, ALooper *looper, int ident, ALooper_callbackFunc callback, void *data) {
         ((FakeLooper *)(void *)looper)->attachInputQueue(ident, callback, data);
+        std::lock_guard<std::mutex> lock(attachedLoopersMutex);
+        attachedLoopers[queue] = (FakeLooper *)(void *)looper;
+    };
+    syms["AInputQueue_detachLooper"] = (void *)+[](AInputQueue *queue) {
+        FakeLooper *looper;
+        {
+            std::lock_guard<std::mutex> lock(attachedLoopersMutex);
+            auto it = attachedLoopers.find(queue);
+            if(it == attachedLoopers.end())
+                return;
+            looper = it->second;
+            attachedLoopers.erase(it);
+        }
+        looper->detachInputQueue();
     };
 
     syms["ANativeActivity_finish"] = (void *)+[](ANativeActivity *native) {
@@ -86,58 +128,304 @@ void FakeLooper::prepare() {
     associatedWindow->makeCurrent(false);
 }
 
+FakeLooper::FakeLooper() {
+#ifdef __linux__
+    wakeReadFd = wakeWriteFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(wakeReadFd < 0 || epollFd < 0)
+        throw std::runtime_error(std::string("Failed to create the looper: ") + strerror(errno));
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = wakeReadFd;
+    if(epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeReadFd, &event) != 0) {
+        auto error = std::string("Failed to add the wake fd to the looper: ") + strerror(errno);
+        close(epollFd);
+        close(wakeReadFd);
+        throw std::runtime_error(error);
+    }
+#else
+    int fds[2];
+    if(pipe(fds) != 0)
+        throw std::runtime_error(std::string("Failed to create the looper: ") + strerror(errno));
+    for(int fd : fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    wakeReadFd = fds[0];
+    wakeWriteFd = fds[1];
+#endif
+}
+
 FakeLooper::~FakeLooper() {
+    {
+        std::lock_guard<std::mutex> lock(attachedLoopersMutex);
+        for(auto it = attachedLoopers.begin(); it != attachedLoopers.end();) {
+            if(it->second == this)
+                it = attachedLoopers.erase(it);
+            else
+                ++it;
+        }
+    }
     CorePatches::setGameWindow(nullptr);
     associatedWindow.reset();
     associatedWindowCallbacks.reset();
+#ifdef __linux__
+    close(epollFd);
+#else
+    close(wakeWriteFd);
+#endif
+    close(wakeReadFd);
 }
 
+#ifdef __linux__
+static uint32_t toEpollEvents(int events) {
+    return ((events & ALOOPER_EVENT_INPUT) ? EPOLLIN : 0) | ((events & ALOOPER_EVENT_OUTPUT) ? EPOLLOUT : 0);
+}
+
+static int fromEpollEvents(uint32_t events) {
+    return ((events & EPOLLIN) ? ALOOPER_EVENT_INPUT : 0) | ((events & EPOLLOUT) ? ALOOPER_EVENT_OUTPUT : 0) |
+           ((events & EPOLLERR) ? ALOOPER_EVENT_ERROR : 0) | ((events & EPOLLHUP) ? ALOOPER_EVENT_HANGUP : 0);
+}
+#else
+static short toPollEvents(int events) {
+    return ((events & ALOOPER_EVENT_INPUT) ? POLLIN : 0) | ((events & ALOOPER_EVENT_OUTPUT) ? POLLOUT : 0);
+}
+
+static int fromPollEvents(short events) {
+    return ((events & POLLIN) ? ALOOPER_EVENT_INPUT : 0) | ((events & POLLOUT) ? ALOOPER_EVENT_OUTPUT : 0) | ((events & POLLERR) ? ALOOPER_EVENT_ERROR : 0) |
+           ((events & POLLHUP) ? ALOOPER_EVENT_HANGUP : 0) | ((events & POLLNVAL) ? ALOOPER_EVENT_INVALID : 0);
+}
+#endif
+
 int FakeLooper::addFd(int fd, int ident, int events, ALooper_callbackFunc callback, void *data) {
-    if(androidEvent)
+    if(callback != nullptr) {
+        ident = ALOOPER_POLL_CALLBACK;
+    } else if(ident < 0) {
+        Log::error("FakeLooper", "addFd: an fd without callback needs an ident >= 0");
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(requestsMutex);
+#ifdef __linux__
+    epoll_event event = {};
+    event.events = toEpollEvents(events);
+    event.data.fd = fd;
+    if(epoll_ctl(epollFd, requests.count(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) != 0) {
+        Log::error("FakeLooper", "addFd: epoll_ctl failed for fd %d: %s", fd, strerror(errno));
         return -1;
-    if(callback != nullptr)
-        throw std::runtime_error("callback is not supported");
-    androidEvent = EventEntry(fd, ident, events, data);
+    }
+#endif
+    requests[fd] = Request{fd, ident, events, callback, data};
+#ifndef __linux__
+    // A thread blocked in poll only sees the new fd with the next call
+    wake();
+#endif
+    return 1;
+}
+
+int FakeLooper::removeFd(int fd) {
+    std::lock_guard<std::mutex> lock(requestsMutex);
+    if(!requests.erase(fd))
+        return 0;
+#ifdef __linux__
+    if(epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr) != 0)
+        Log::error("FakeLooper", "removeFd: epoll_ctl failed for fd %d: %s", fd, strerror(errno));
+#endif
     return 1;
 }
 
 void FakeLooper::attachInputQueue(int ident, ALooper_callbackFunc callback, void *data) {
-    if(inputEntry)
+    if(hasInputQueue)
         throw std::runtime_error("attachInputQueue already called on this looper");
-    if(callback != nullptr)
-        throw std::runtime_error("callback is not supported");
-    inputEntry = EventEntry(-1, ident, 0, data);
+    hasInputQueue = true;
+    inputRequest = Request{fakeInputQueue.getFd(), callback ? ALOOPER_POLL_CALLBACK : ident, ALOOPER_EVENT_INPUT, callback, data};
+#ifdef __linux__
+    // Only wakes up the wait, the events are taken from the queue itself
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fakeInputQueue.getFd();
+    if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fakeInputQueue.getFd(), &event) != 0) {
+        hasInputQueue = false;
+        throw std::runtime_error(std::string("attachInputQueue: epoll_ctl failed: ") + strerror(errno));
+    }
+#endif
 }
 
-int FakeLooper::pollAll(int timeoutMillis, int *outFd, int *outEvents, void **outData) {
-    associatedWindowCallbacks->startSendEvents();
-    if(textInput != jniSupport->getTextInputHandler().isEnabled()) {
-        textInput = jniSupport->getTextInputHandler().isEnabled();
-        if(textInput) {
-            associatedWindow->startTextInput();
-        } else {
-            associatedWindow->stopTextInput();
+void FakeLooper::detachInputQueue() {
+    if(!hasInputQueue)
+        return;
+    hasInputQueue = false;
+#ifdef __linux__
+    if(epoll_ctl(epollFd, EPOLL_CTL_DEL, fakeInputQueue.getFd(), nullptr) != 0)
+        Log::error("FakeLooper", "detachInputQueue: epoll_ctl failed: %s", strerror(errno));
+#endif
+}
+
+void FakeLooper::wake() {
+#ifdef __linux__
+    uint64_t value = 1;
+#else
+    char value = 1;
+#endif
+    if(write(wakeWriteFd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        Log::error("FakeLooper", "wake failed: %s", strerror(errno));
+}
+
+int FakeLooper::pollInputQueue(int *outFd, int *outEvents, void **outData) {
+    if(!hasInputQueue || !fakeInputQueue.hasEvents())
+        return ALOOPER_POLL_TIMEOUT;
+    if(inputRequest.callback) {
+        if(!inputRequest.callback(inputRequest.fd, ALOOPER_EVENT_INPUT, inputRequest.data))
+            detachInputQueue();
+        return ALOOPER_POLL_CALLBACK;
+    }
+    if(outFd)
+        *outFd = inputRequest.fd;
+    if(outEvents)
+        *outEvents = ALOOPER_EVENT_INPUT;
+    if(outData)
+        *outData = inputRequest.data;
+    return inputRequest.ident;
+}
+
+int FakeLooper::waitAndDispatch(int timeoutMillis) {
+    std::vector<std::pair<int, int>> ready;
+    bool woken = false;
+#ifdef __linux__
+    epoll_event events[16];
+    int count = epoll_wait(epollFd, events, 16, timeoutMillis);
+    if(count < 0)
+        return errno == EINTR ? ALOOPER_POLL_WAKE : ALOOPER_POLL_ERROR;
+    for(int i = 0; i < count; i++) {
+        int fd = events[i].data.fd;
+        if(fd == wakeReadFd)
+            woken = true;
+        else
+            ready.emplace_back(fd, fromEpollEvents(events[i].events));
+    }
+#else
+    std::vector<pollfd> fds = {{wakeReadFd, POLLIN, 0}};
+    if(hasInputQueue)
+        fds.push_back({fakeInputQueue.getFd(), POLLIN, 0});
+    {
+        std::lock_guard<std::mutex> lock(requestsMutex);
+        for(auto &&request : requests)
+            fds.push_back({request.first, toPollEvents(request.second.events), 0});
+    }
+    int count = poll(fds.data(), fds.size(), timeoutMillis);
+    if(count < 0)
+        return errno == EINTR ? ALOOPER_POLL_WAKE : ALOOPER_POLL_ERROR;
+    woken = fds[0].revents != 0;
+    for(size_t i = 1; i < fds.size(); i++) {
+        if(fds[i].revents)
+            ready.emplace_back(fds[i].fd, fromPollEvents(fds[i].revents));
+    }
+#endif
+    int result = ALOOPER_POLL_TIMEOUT;
+    if(woken) {
+        char buf[16];
+        while(read(wakeReadFd, buf, sizeof(buf)) > 0) {
         }
+        result = ALOOPER_POLL_WAKE;
     }
-    
-    if(androidEvent) {
-        pollfd f;
-        f.fd = androidEvent.fd;
-        f.events = androidEvent.events;
-        if(poll(&f, 1, 0) > 0) {
-            androidEvent.fill(outFd, outData);
-            if(outEvents)
-                *outEvents = f.revents;
-            return androidEvent.ident;
+
+    std::vector<Response> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(requestsMutex);
+        for(auto &&fd : ready) {
+            auto it = requests.find(fd.first);
+            if(it == requests.end())
+                continue;
+            if(it->second.callback)
+                callbacks.push_back({it->second, fd.second});
+            else
+                responses.push_back({it->second, fd.second});
+        }
+    }
+    // Invoked without the lock, callbacks may add or remove fds
+    for(auto &&response : callbacks) {
+        if(!response.request.callback(response.request.fd, response.events, response.request.data))
+            removeFd(response.request.fd);
+        result = ALOOPER_POLL_CALLBACK;
+    }
+    return result;
+}
+
+int FakeLooper::pollOnce(int timeoutMillis, int *outFd, int *outEvents, void **outData) {
+    if(associatedWindowCallbacks) {
+        associatedWindowCallbacks->startSendEvents();
+        if(textInput != jniSupport->getTextInputHandler().isEnabled()) {
+            textInput = jniSupport->getTextInputHandler().isEnabled();
+            if(textInput) {
+                associatedWindow->startTextInput();
+            } else {
+                associatedWindow->stopTextInput();
+            }
         }
     }
 
-    if(inputEntry && fakeInputQueue.hasEvents()) {
-        inputEntry.fill(outFd, outData);
-        return inputEntry.ident;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMillis, 0));
+    while(true) {
+        if(!responses.empty()) {
+            auto response = responses.front();
+            responses.pop_front();
+            {
+                // Skip fds removed since they became ready
+                std::lock_guard<std::mutex> lock(requestsMutex);
+                if(!requests.count(response.request.fd))
+                    continue;
+            }
+            if(outFd)
+                *outFd = response.request.fd;
+            if(outEvents)
+                *outEvents = response.events;
+            if(outData)
+                *outData = response.request.data;
+            return response.request.ident;
+        }
+
+        int result = pollInputQueue(outFd, outEvents, outData);
+        if(result != ALOOPER_POLL_TIMEOUT)
+            return result;
+        if(associatedWindow) {
+            associatedWindow->pollEvents();
+            fakeInputQueue.flush();
+            result = pollInputQueue(outFd, outEvents, outData);
+            if(result != ALOOPER_POLL_TIMEOUT)
+                return result;
+        }
+
+        int waitMillis = timeoutMillis;
+        if(timeoutMillis > 0)
+            waitMillis = (int)std::max<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count(), 0);
+        // The window backends have no fd to wait on, blocking polls still wake up this often to pump its events
+        int windowPollIntervalMillis = std::max(Settings::windowPollIntervalMillis, 1);
+        if(associatedWindow && (waitMillis < 0 || waitMillis > windowPollIntervalMillis))
+            waitMillis = windowPollIntervalMillis;
+        result = waitAndDispatch(waitMillis);
+        if(!responses.empty())
+            continue;
+        if(result != ALOOPER_POLL_TIMEOUT)
+            return result;
+        if(timeoutMillis == 0 || (timeoutMillis > 0 && std::chrono::steady_clock::now() >= deadline))
+            return ALOOPER_POLL_TIMEOUT;
     }
+}
 
-    associatedWindow->pollEvents();
-    associatedWindowCallbacks->markRequeueGamepadInput();
-    return ALOOPER_POLL_TIMEOUT;
+int FakeLooper::pollAll(int timeoutMillis, int *outFd, int *outEvents, void **outData) {
+    if(timeoutMillis <= 0) {
+        int result;
+        do {
+            result = pollOnce(timeoutMillis, outFd, outEvents, outData);
+        } while(result == ALOOPER_POLL_CALLBACK);
+        return result;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    while(true) {
+        int result = pollOnce(timeoutMillis, outFd, outEvents, outData);
+        if(result != ALOOPER_POLL_CALLBACK)
+            return result;
+        timeoutMillis = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if(timeoutMillis <= 0)
+            return ALOOPER_POLL_TIMEOUT;
+    }
 }
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <android/looper.h>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <game_window.h>
 #include "jni/jni_support.h"
 #include "window_callbacks.h"
@@ -11,30 +14,33 @@ class FakeLooper {
 private:
     static JniSupport *jniSupport;
     static thread_local std::unique_ptr<FakeLooper> currentLooper;
+    // The looper each input queue is attached to, detaching may happen on another thread
+    static std::mutex attachedLoopersMutex;
+    static std::unordered_map<AInputQueue *, FakeLooper *> attachedLoopers;
     bool prepared = false;
     bool textInput = false;
     int menuSize = 0;
 
-    struct EventEntry {
+    struct Request {
         int fd, ident, events;
+        ALooper_callbackFunc callback;
         void *data;
-
-        EventEntry() : ident(-1) {}
-        EventEntry(int fd, int ident, int events, void *data) : fd(fd), ident(ident), events(events), data(data) {}
-
-        void fill(int *outFd, void **outData) const {
-            if(outFd)
-                *outFd = fd;
-            if(outData)
-                *outData = data;
-        }
-
-        operator bool const() {
-            return ident != -1;
-        }
     };
-    EventEntry androidEvent;
-    EventEntry inputEntry;
+    struct Response {
+        Request request;
+        int events;
+    };
+    // eventfd on linux, both ends of a pipe elsewhere
+    int wakeReadFd = -1, wakeWriteFd = -1;
+#ifdef __linux__
+    int epollFd = -1;
+#endif
+    std::mutex requestsMutex;
+    std::unordered_map<int, Request> requests;
+    // Ready fds without a callback, returned one per poll
+    std::deque<Response> responses;
+    bool hasInputQueue = false;
+    Request inputRequest;
     FakeInputQueue fakeInputQueue;
 
     std::shared_ptr<GameWindow> associatedWindow;
@@ -42,19 +48,35 @@ private:
 
     void initializeWindow();
 
+    int pollInputQueue(int *outFd, int *outEvents, void **outData);
+
+    // Waits for the fds and the wake fd, runs the callbacks and queues the other responses
+    int waitAndDispatch(int timeoutMillis);
+
 public:
     static void setJniSupport(JniSupport *support) {
         jniSupport = support;
     }
 
+    FakeLooper();
+
     ~FakeLooper();
 
     void prepare();
 
     int addFd(int fd, int ident, int events, ALooper_callbackFunc callback, void *data);
 
+    int removeFd(int fd);
+
     void attachInputQueue(int ident, ALooper_callbackFunc callback, void *data);
 
+    void detachInputQueue();
+
+    // Safe to call from any thread
+    void wake();
+
+    int pollOnce(int timeoutMillis, int *outFd, int *outEvents, void **outData);
+
     int pollAll(int timeoutMillis, int *outFd, int *outEvents, void **outData);
 
     static void initWindow();
@@ -0,0 +1,181 @@
+#include "game_library_probe.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <log.h>
+
+static constexpr uint32_t SHT_DYNAMIC_ = 6;
+static constexpr uint32_t SHT_NOTE_ = 7;
+static constexpr uint32_t SHT_DYNSYM_ = 11;
+static constexpr uint64_t DT_NEEDED_ = 1;
+static constexpr unsigned STB_WEAK_ = 2;
+static constexpr uint32_t NT_GNU_BUILD_ID_ = 3;
+
+static uint16_t read16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read64(const unsigned char *p) {
+    return (uint64_t)read32(p) | ((uint64_t)read32(p + 4) << 32);
+}
+
+GameLibraryProbe::GameLibraryProbe(std::string path, std::vector<std::string> watchedExports) : path(std::move(path)), watchedExports(std::move(watchedExports)) {
+    int fd = open(this->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        throw std::runtime_error("Failed to open " + this->path + ": " + strerror(errno));
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 64) {
+        close(fd);
+        throw std::runtime_error(this->path + " is not an ELF file");
+    }
+    void *m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(m == MAP_FAILED)
+        throw std::runtime_error("Failed to map " + this->path + ": " + strerror(errno));
+    mapping = (const unsigned char *)m;
+    mappingSize = (size_t)st.st_size;
+
+    try {
+        if(memcmp(mapping, "\x7f" "ELF", 4) != 0 || (mapping[4] != 1 && mapping[4] != 2) || mapping[5] != 1)
+            throw std::runtime_error(this->path + " is not a little endian ELF file");
+        is64 = mapping[4] == 2;
+        readSections();
+    } catch(...) {
+        munmap((void *)mapping, mappingSize);
+        throw;
+    }
+}
+
+GameLibraryProbe::~GameLibraryProbe() {
+    munmap((void *)mapping, mappingSize);
+}
+
+const unsigned char *GameLibraryProbe::at(uint64_t offset, uint64_t size) const {
+    if(offset > mappingSize || size > mappingSize - offset)
+        throw std::runtime_error(path + ": truncated ELF file");
+    return mapping + offset;
+}
+
+std::string GameLibraryProbe::readString(uint64_t tableOffset, uint64_t tableSize, uint64_t index) const {
+    if(index >= tableSize)
+        throw std::runtime_error(path + ": string index out of range");
+    auto table = (const char *)at(tableOffset, tableSize);
+    return std::string(table + index, strnlen(table + index, tableSize - index));
+}
+
+void GameLibraryProbe::readSections() {
+    struct Section {
+        uint32_t type;
+        uint64_t offset;
+        uint64_t size;
+        uint32_t link;
+    };
+    uint64_t shoff = is64 ? read64(at(0x28, 8)) : read32(at(0x20, 4));
+    uint16_t shentsize = read16(at(is64 ? 0x3A : 0x2E, 2));
+    uint16_t shnum = read16(at(is64 ? 0x3C : 0x30, 2));
+    if(shoff == 0 || shnum == 0)
+        throw std::runtime_error(path + " has no section headers");
+    std::vector<Section> sections;
+    for(uint16_t i = 0; i < shnum; i++) {
+        auto sh = at(shoff + (uint64_t)i * shentsize, is64 ? 64 : 40);
+        if(is64)
+            sections.push_back({read32(sh + 4), read64(sh + 24), read64(sh + 32), read32(sh + 40)});
+        else
+            sections.push_back({read32(sh + 4), read32(sh + 16), read32(sh + 20), read32(sh + 24)});
+    }
+    auto linkedStrings = [&](Section const &section) -> Section const & {
+        if(section.link >= sections.size())
+            throw std::runtime_error(path + ": invalid string table link");
+        return sections[section.link];
+    };
+
+    for(auto &&section : sections) {
+        if(section.type == SHT_DYNSYM_) {
+            auto &strtab = linkedStrings(section);
+            size_t entsize = is64 ? 24 : 16;
+            // The first symbol is the reserved null symbol
+            for(uint64_t i = 1; i < section.size / entsize; i++) {
+                auto sym = at(section.offset + i * entsize, entsize);
+                uint32_t name = read32(sym);
+                unsigned char info = is64 ? sym[4] : sym[12];
+                uint16_t shndx = read16(is64 ? sym + 6 : sym + 14);
+                if(name == 0)
+                    continue;
+                auto symbolName = readString(strtab.offset, strtab.size, name);
+                if(symbolName == "bgfx_init")
+                    renderDragon = true;
+                if(shndx != 0 && std::find(watchedExports.begin(), watchedExports.end(), symbolName) != watchedExports.end())
+                    exportedWatched.push_back(symbolName);
+                if(shndx == 0 && (info >> 4) != STB_WEAK_)
+                    importedSymbols.push_back(std::move(symbolName));
+            }
+        } else if(section.type == SHT_DYNAMIC_) {
+            auto &strtab = linkedStrings(section);
+            size_t entsize = is64 ? 16 : 8;
+            for(uint64_t i = 0; i < section.size / entsize; i++) {
+                auto dyn = at(section.offset + i * entsize, entsize);
+                uint64_t tag = is64 ? read64(dyn) : read32(dyn);
+                uint64_t val = is64 ? read64(dyn + 8) : read32(dyn + 4);
+                if(tag == 0)
+                    break;
+                if(tag == DT_NEEDED_)
+                    neededLibraries.push_back(readString(strtab.offset, strtab.size, val));
+            }
+        } else if(section.type == SHT_NOTE_ && buildId.empty()) {
+            uint64_t offset = section.offset;
+            while(offset + 12 <= section.offset + section.size) {
+                auto note = at(offset, 12);
+                uint32_t nameSize = read32(note), descSize = read32(note + 4), type = read32(note + 8);
+                uint64_t nameOffset = offset + 12;
+                uint64_t descOffset = nameOffset + ((nameSize + 3) & ~3u);
+                if(type == NT_GNU_BUILD_ID_ && nameSize == 4 && memcmp(at(nameOffset, 4), "GNU", 4) == 0) {
+                    static const char hex[] = "0123456789abcdef";
+                    auto desc = at(descOffset, descSize);
+                    for(uint32_t i = 0; i < descSize; i++) {
+                        buildId += hex[desc[i] >> 4];
+                        buildId += hex[desc[i] & 0xF];
+                    }
+                    break;
+                }
+                offset = descOffset + ((descSize + 3) & ~3u);
+            }
+        }
+    }
+}
+
+std::vector<std::string> GameLibraryProbe::getImportedSymbolsContaining(std::string const &substring) const {
+    std::vector<std::string> ret;
+    for(auto &&symbol : importedSymbols) {
+        if(symbol.find(substring) != std::string::npos)
+            ret.push_back(symbol);
+    }
+    return ret;
+}
+
+bool GameLibraryProbe::importsGLES() const {
+    if(std::find(neededLibraries.begin(), neededLibraries.end(), "libGLESv2.so") == neededLibraries.end() &&
+       std::find(neededLibraries.begin(), neededLibraries.end(), "libGLESv3.so") == neededLibraries.end())
+        return false;
+    return std::any_of(importedSymbols.begin(), importedSymbols.end(), [](std::string const &symbol) {
+        return symbol.size() > 2 && symbol[0] == 'g' && symbol[1] == 'l' && isupper((unsigned char)symbol[2]);
+    });
+}
+
+bool GameLibraryProbe::exports(std::string const &symbol) const {
+    return std::find(exportedWatched.begin(), exportedWatched.end(), symbol) != exportedWatched.end();
+}
+
+bool GameLibraryProbe::usesRenderDragon() const {
+    return renderDragon;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reads the dynamic linking information of the game library from disk without loading it,
+// so the graphics api and fmod strategy can be chosen before the (expensive) first load attempt
+class GameLibraryProbe {
+private:
+    std::string path;
+    const unsigned char *mapping = nullptr;
+    size_t mappingSize = 0;
+    bool is64 = false;
+    std::vector<std::string> neededLibraries;
+    std::vector<std::string> importedSymbols;
+    bool renderDragon = false;
+    std::string buildId;
+    std::vector<std::string> watchedExports;
+    std::vector<std::string> exportedWatched;
+
+    const unsigned char *at(uint64_t offset, uint64_t size) const;
+
+    std::string readString(uint64_t tableOffset, uint64_t tableSize, uint64_t index) const;
+
+    void readSections();
+
+public:
+    // Throws std::runtime_error if the file can't be mapped or isn't a little endian ELF shared library
+    // watchedExports are the defined symbols exports() can be asked about, all others aren't recorded
+    explicit GameLibraryProbe(std::string path, std::vector<std::string> watchedExports = {});
+
+    GameLibraryProbe(GameLibraryProbe const &) = delete;
+    GameLibraryProbe &operator=(GameLibraryProbe const &) = delete;
+
+    ~GameLibraryProbe();
+
+    std::vector<std::string> const &getNeededLibraries() const { return neededLibraries; }
+
+    // Undefined and not weak, the load fails if any of these can't be resolved
+    std::vector<std::string> const &getImportedSymbols() const { return importedSymbols; }
+
+    // Hex string of the NT_GNU_BUILD_ID note, empty if the library has none
+    std::string const &getBuildId() const { return buildId; }
+
+    // Imported symbols containing the substring, e.g. "FMOD" for the (mangled) fmod api
+    std::vector<std::string> getImportedSymbolsContaining(std::string const &substring) const;
+
+    // The game calls gl functions directly instead of through eglGetProcAddress, the empty libGLESv2.so stub of the glcorepatch can't satisfy it
+    bool importsGLES() const;
+
+    // Only answers for the watchedExports given to the constructor
+    bool exports(std::string const &symbol) const;
+
+    // bgfx based renderer of newer game versions
+    bool usesRenderDragon() const;
+};
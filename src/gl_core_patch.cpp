@@ -4,8 +4,10 @@
 #include <mcpelauncher/linker.h>
 #include <log.h>
 #include <mcpelauncher/minecraft_version.h>
-#include <mcpelauncher/patch_utils.h>
 #include <stdexcept>
+#include "patch_site_cache.h"
+#include "pattern_scanner.h"
+#include "symbol_index.h"
 
 bool GLCorePatch::enabled = false;
 std::unordered_map<unsigned int, unsigned int> GLCorePatch::vaoMap;
@@ -18,25 +20,35 @@ void (*GLCorePatch::glUseProgram_orig)(unsigned int program);
 void (*GLCorePatch::glBindBuffer_orig)(int target, unsigned int buffer);
 
 void GLCorePatch::install(void *handle) {
-    if(linker::dlsym(handle, "bgfx_init")) {
+    if(SymbolIndex::resolve(handle, "bgfx_init")) {
         throw std::runtime_error("Glcore patch not supported on render dragon versions");
     }
-#if __i386__
-    void *ptr = PatchUtils::patternSearch(handle, "53 83 EC 18 E8 00 00 00 00 5B 81 C3 ?? ?? ?? ?? 8B 83 ?? ?? ?? ?? 85 C0 79 5F 8D 44 24 08 89 04 24 E8 ?? ?? ?? ?? 83 EC 04 8B 44 24 08 83 F8 02");
-#elif __x86_64__
-    void *ptr = PatchUtils::patternSearch(handle, "8B 15 ?? ?? ?? ?? 85 D2 78 07 83 FA 01 0F 94 C0 C3 50 E8 ?? ?? ?? ?? C1 EA 10 F7 D2 83 E2 01 89");
+    void *ptr = PatchSiteCache::find("GLCorePatch::supportsImmediateMode", 16);
+#if defined(__i386__) || defined(__x86_64__)
     if(!ptr) {
-        ptr = PatchUtils::patternSearch(handle, "50 ?? ?? ?? ?? ?? ?? 85 d2 ?? ?? ?? ?? ?? ?? ?? c1 ea 10 f7 d2 83 e2 01"); // Pattern for 1.17-1.18.12
-    }
+        // All patterns in one pass, the first one in this list which matched wins
+        PatternScanner scanner;
+#if __i386__
+        scanner.add("53 83 EC 18 E8 00 00 00 00 5B 81 C3 ?? ?? ?? ?? 8B 83 ?? ?? ?? ?? 85 C0 79 5F 8D 44 24 08 89 04 24 E8 ?? ?? ?? ?? 83 EC 04 8B 44 24 08 83 F8 02");
 #else
-    void *ptr = nullptr;
+        scanner.add("8B 15 ?? ?? ?? ?? 85 D2 78 07 83 FA 01 0F 94 C0 C3 50 E8 ?? ?? ?? ?? C1 EA 10 F7 D2 83 E2 01 89");
+        scanner.add("50 ?? ?? ?? ?? ?? ?? 85 d2 ?? ?? ?? ?? ?? ?? ?? c1 ea 10 f7 d2 83 e2 01"); // Pattern for 1.17-1.18.12
+#endif
+        for(auto match : scanner.findFirst(handle)) {
+            if(match) {
+                ptr = match;
+                break;
+            }
+        }
+    }
 #endif
     if(!ptr) {
-        ptr = linker::dlsym(handle, "_ZN2gl21supportsImmediateModeEv");
+        ptr = SymbolIndex::resolve(handle, "_ZN2gl21supportsImmediateModeEv");
     }
 
     if(!ptr)
         throw std::runtime_error("Failed to find gl::supportsImmediateMode");
+    PatchSiteCache::store("GLCorePatch::supportsImmediateMode", ptr, 16);
     unsigned char replace[6] = {0xB8, 0x00, 0x00, 0x00, 0x00, 0xC3};
     memcpy(ptr, replace, 6);
 
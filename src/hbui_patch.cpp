@@ -2,12 +2,13 @@
 #include <mcpelauncher/linker.h>
 #include <mcpelauncher/patch_utils.h>
 #include <log.h>
+#include "symbol_index.h"
 
 void HbuiPatch::install(void* handle) {
-    void* ptr = linker::dlsym(handle, "_ZN6cohtml17VerifiyLicenseKeyEPKc");
+    void* ptr = SymbolIndex::resolve(handle, "_ZN6cohtml17VerifiyLicenseKeyEPKc");
     if(ptr)
         PatchUtils::patchCallInstruction(ptr, (void*)returnTrue, true);
-    ptr = linker::dlsym(handle, "_ZN4hbui10LogHandler8WriteLogEN6cohtml7Logging8SeverityEPKcj");
+    ptr = SymbolIndex::resolve(handle, "_ZN4hbui10LogHandler8WriteLogEN6cohtml7Logging8SeverityEPKcj");
     if(ptr)
         PatchUtils::patchCallInstruction(ptr, (void*)writeLog, true);
 }
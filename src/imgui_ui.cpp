@@ -19,6 +19,7 @@
 #include <sstream>
 #include "window_callbacks.h"
 #include "core_patches.h"
+#include "asset_stats.h"
 #include <mutex>
 #include <mcpelauncher/linker.h>
 
@@ -430,6 +431,9 @@ void ImGuiUIDrawFrame(GameWindow* window) {
                 Settings::menubarFocusKey = Settings::menubarFocusKey == "alt" ? "" : "alt";
                 Settings::save();
             }
+            if(ImGui::MenuItem("Dump Asset Statistics")) {
+                AssetStats::dump(AssetStats::getDefaultDumpPath());
+            }
 
             if(ImGui::MenuItem("Close")) {
                 window->close();
@@ -8,6 +8,7 @@
 #include "cert_manager.h"
 #include "package_source.h"
 #include "../xbox_live_helper.h"
+#include "../startup_profiler.h"
 #include "http_stub.h"
 #ifdef HAVE_PULSEAUDIO
 #include "pulseaudio.h"
@@ -37,6 +38,7 @@
 #include <sys/stat.h>
 #include <regex>
 #include <sstream>
+#include <algorithm>
 #if !defined(_GLIBCXX_RELEASE) || _GLIBCXX_RELEASE > 8
 #include <filesystem>
 #endif
@@ -120,7 +122,7 @@ void JniSupport::registerJniClasses() {
 #endif
 }
 
-void JniSupport::registerMinecraftNatives(void *(*symResolver)(const char *)) {
+void JniSupport::registerMinecraftNatives(SymbolResolver symResolver) {
     registerNatives(MainActivity::getDescriptor(), {{"nativeRegisterThis", "()V"}, {"nativeWaitCrashManagementSetupComplete", "()V"}, {"nativeInitializeWithApplicationContext", "(Landroid/content/Context;)V"}, {"nativeShutdown", "()V"}, {"nativeUnregisterThis", "()V"}, {"nativeStopThis", "()V"}, {"nativeOnDestroy", "()V"}, {"nativeResize", "(II)V"}, {"nativeSetTextboxText", "(Ljava/lang/String;)V"}, {"nativeCaretPosition", "(I)V"}, { "nativeBackPressed", "()V"}, {"nativeReturnKeyPressed", "()V"}, {"nativeOnPickImageSuccess", "(JLjava/lang/String;)V"}, {"nativeOnPickImageCanceled", "(J)V"}, {"nativeOnPickFileSuccess", "(Ljava/lang/String;)V"}, {"nativeOnPickFileCanceled", "()V"}, {"nativeInitializeXboxLive", "(JJ)V"}, {"nativeinitializeLibHttpClient", "(J)J"}, {"nativeInitializeLibHttpClient", "(J)J"}, {"nativeProcessIntentUriQuery", "(Ljava/lang/String;Ljava/lang/String;)V"}, {"nativeSetIntegrityToken", "(Ljava/lang/String;)V"}, {"nativeRunNativeCallbackOnUiThread", "(J)V"}}, symResolver);
     registerNatives(NetworkMonitor::getDescriptor(), {{"nativeUpdateNetworkStatus", "(ZZZ)V"}}, symResolver);
     registerNatives(NativeStoreListener::getDescriptor(), {
@@ -188,22 +190,26 @@ JniSupport::JniSupport() : textInput([this](std::string const &str) { return onS
 }
 
 void JniSupport::registerNatives(std::shared_ptr<FakeJni::JClass const> clazz,
-                                 std::vector<JniSupport::NativeEntry> entries, void *(*symResolver)(const char *)) {
+                                 std::vector<JniSupport::NativeEntry> entries, SymbolResolver symResolver) {
     FakeJni::LocalFrame frame(vm);
 
     std::string cppClassName = clazz->getName();
     std::replace(cppClassName.begin(), cppClassName.end(), '/', '_');
 
+    std::vector<std::string> cppSymNames;
+    for(auto const &ent : entries)
+        cppSymNames.push_back(std::string("Java_") + cppClassName + "_" + ent.name);
+    std::vector<void *> cppSyms;
+    symResolver(cppSymNames, cppSyms);
+
     std::vector<JNINativeMethod> javaEntries;
-    for(auto const &ent : entries) {
-        auto cppSymName = std::string("Java_") + cppClassName + "_" + ent.name;
-        auto cppSym = symResolver(cppSymName.c_str());
-        if(cppSym == nullptr) {
-            Log::error("JniSupport", "Missing native symbol: %s", cppSymName.c_str());
+    for(size_t i = 0; i < entries.size(); i++) {
+        if(cppSyms[i] == nullptr) {
+            Log::error("JniSupport", "Missing native symbol: %s", cppSymNames[i].c_str());
             continue;
         }
 
-        javaEntries.push_back({(char *)ent.name, (char *)ent.sig, cppSym});
+        javaEntries.push_back({(char *)entries[i].name, (char *)entries[i].sig, cppSyms[i]});
     }
 
     auto jClazz = frame.getJniEnv().createLocalReference(std::const_pointer_cast<FakeJni::JClass>(clazz));
@@ -211,8 +217,13 @@ void JniSupport::registerNatives(std::shared_ptr<FakeJni::JClass const> clazz,
         throw std::runtime_error("RegisterNatives failed");
 }
 
+void JniSupport::setAssetManager(std::unique_ptr<FakeAssetManager> assetManager) {
+    this->assetManager = std::move(assetManager);
+}
+
 void JniSupport::startGame(ANativeActivity_createFunc *activityOnCreate,
                            void *stbiLoadFromMemory, void *stbiImageFree) {
+    StartupProfiler::Scope startScope("JniSupport::startGame");
     FakeJni::LocalFrame frame(vm);
 
     vm.attachLibrary("libfmod.so", "", {linker::dlopen, linker::dlsym, linker::dlclose_unlocked});
@@ -227,7 +238,9 @@ void JniSupport::startGame(ANativeActivity_createFunc *activityOnCreate,
     activity->stbi_load_from_memory = (decltype(activity->stbi_load_from_memory))stbiLoadFromMemory;
     activity->stbi_image_free = (decltype(activity->stbi_image_free))stbiImageFree;
 
-    assetManager = std::make_unique<FakeAssetManager>(PathHelper::getGameDir() + "assets");
+    if(!assetManager)
+        assetManager = std::make_unique<FakeAssetManager>(PathHelper::getGameDir() + "assets", options.assetsArchive, options.assetOverlays);
+    assetManager->cache.setByteBudget((size_t)std::max(Settings::assetCacheSizeMb, 0) * 1024 * 1024);
 
     XboxLiveHelper::getInstance().setJvm(&vm);
 
@@ -246,12 +259,16 @@ void JniSupport::startGame(ANativeActivity_createFunc *activityOnCreate,
         registerThis->invoke(frame.getJniEnv(), activity.get());
 
     Log::trace("JniSupport", "Invoking ANativeActivity_onCreate\n");
+    StartupProfiler::Scope onCreateScope("ANativeActivity_onCreate");
     activityOnCreate(&nativeActivity, nullptr, 0);
+    onCreateScope.end();
 
     Log::trace("JniSupport", "Invoking start activity callbacks\n");
+    StartupProfiler::Scope callbacksScope("start activity callbacks");
     nativeActivityCallbacks.onInputQueueCreated(&nativeActivity, inputQueue);
     nativeActivityCallbacks.onStart(&nativeActivity);
     nativeActivityCallbacks.onNativeWindowCreated(&nativeActivity, window);
+    callbacksScope.end();
     // nativeActivityCallbacks.onResume(&nativeActivity);
 
     std::shared_ptr<NetworkMonitor> network;
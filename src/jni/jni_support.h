@@ -32,13 +32,21 @@ private:
 
     void registerJniClasses();
 
+public:
+    // Resolves all symbol names at once, symbols gets one entry per name and nullptr for missing ones
+    using SymbolResolver = void (*)(std::vector<std::string> const &names, std::vector<void *> &symbols);
+
+private:
     void registerNatives(std::shared_ptr<FakeJni::JClass const> clazz, std::vector<NativeEntry> entries,
-                         void *(*symResolver)(const char *));
+                         SymbolResolver symResolver);
 
 public:
     JniSupport();
 
-    void registerMinecraftNatives(void *(*symResolver)(const char *));
+    void registerMinecraftNatives(SymbolResolver symResolver);
+
+    // Use an asset manager which was already created during startup, instead of creating one in startGame
+    void setAssetManager(std::unique_ptr<FakeAssetManager> assetManager);
 
     void startGame(ANativeActivity_createFunc *activityOnCreate,
                    void *stbiLoadFromMemory, void *stbiImageFree);
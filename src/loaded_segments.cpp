@@ -0,0 +1,28 @@
+#include "loaded_segments.h"
+#include <cstring>
+#include <mcpelauncher/minecraft_utils.h>
+
+std::vector<LoadedSegment> getLoadedSegments(void *handle) {
+    std::vector<LoadedSegment> ret;
+    // The ELF header and program headers of the game are mapped at the library base
+    auto base = (unsigned char *)MinecraftUtils::getLibraryBase(handle);
+    if(!base || memcmp(base, "\x7f" "ELF", 4) != 0)
+        return ret;
+    bool is64 = sizeof(void *) == 8;
+    uint64_t phoff = 0;
+    uint16_t phentsize, phnum;
+    memcpy(&phoff, base + (is64 ? 0x20 : 0x1C), is64 ? 8 : 4);
+    memcpy(&phentsize, base + (is64 ? 0x36 : 0x2A), 2);
+    memcpy(&phnum, base + (is64 ? 0x38 : 0x2C), 2);
+    for(uint16_t i = 0; i < phnum; i++) {
+        auto ph = base + phoff + (size_t)i * phentsize;
+        uint32_t type, flags;
+        uint64_t vaddr = 0, memsz = 0;
+        memcpy(&type, ph, 4);
+        memcpy(&flags, ph + (is64 ? 4 : 24), 4);
+        memcpy(&vaddr, ph + (is64 ? 16 : 8), is64 ? 8 : 4);
+        memcpy(&memsz, ph + (is64 ? 40 : 20), is64 ? 8 : 4);
+        ret.push_back({type, flags, base + vaddr, (size_t)memsz});
+    }
+    return ret;
+}
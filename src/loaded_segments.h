@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A program header of a library loaded by the linker, start is already relocated to the load address
+struct LoadedSegment {
+    static constexpr uint32_t PT_LOAD_ = 1;
+    static constexpr uint32_t PT_DYNAMIC_ = 2;
+    static constexpr uint32_t PF_X_ = 1;
+
+    uint32_t type;
+    uint32_t flags;
+    unsigned char *start;
+    size_t size;
+
+    // PT_LOAD with PF_X
+    bool isCode() const { return type == PT_LOAD_ && (flags & PF_X_); }
+};
+
+// Reads the program headers mapped at the base of the library, empty if the base doesn't point to an ELF header
+std::vector<LoadedSegment> getLoadedSegments(void *handle);
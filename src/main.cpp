@@ -6,7 +6,6 @@
 #include <mcpelauncher/minecraft_version.h>
 #include <mcpelauncher/crash_handler.h>
 #include <mcpelauncher/path_helper.h>
-#include <mcpelauncher/mod_loader.h>
 #include "window_callbacks.h"
 #include "splitscreen_patch.h"
 #include "gl_core_patch.h"
@@ -29,6 +28,18 @@
 #include "fake_looper.h"
 #include "fake_window.h"
 #include "fake_assetmanager.h"
+#include "asset_prefetch.h"
+#include "asset_stats.h"
+#include "startup_profiler.h"
+#include "startup_task_graph.h"
+#include "game_library_probe.h"
+#include "patch_site_cache.h"
+#include "symbol_index.h"
+#include "mod_manifest.h"
+#include "cpu_topology.h"
+#include "startup_benchmark.h"
+#include "zygote.h"
+#include "code_huge_pages.h"
 #include "fake_egl.h"
 #include "symbols.h"
 #include "core_patches.h"
@@ -66,6 +77,8 @@ LauncherOptions options;
 
 void printVersionInfo();
 
+std::vector<std::string> splitList(std::string const& list);
+
 void loadGameOptions();
 
 int main(int argc, char* argv[]) {
@@ -85,6 +98,7 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    StartupBenchmark::initChild();
     CrashHandler::registerCrashHandler();
     MinecraftUtils::workaroundLocaleBug();
 
@@ -113,6 +127,17 @@ int main(int argc, char* argv[]) {
     argparser::arg<bool> resetSettings(p, "--reset-settings", "-gs", "Save the default Settings", false);
     argparser::arg<bool> freeOnly(p, "--free-only", "-f", "Only allow starting free versions", false);
     argparser::arg<std::string> mods(p, "--mods", "-m", "Additional directories to load mods from split by ','", "");
+    argparser::arg<std::string> assetStats(p, "--asset-stats", "-as", "Write per asset I/O statistics to this file on exit, as csv if it ends with .csv and json otherwise", "");
+    argparser::arg<std::string> assetOverlays(p, "--asset-overlays", "-ao", "Directories or zip files which shadow the game assets split by ',', the first one has the highest priority", "");
+    argparser::arg<std::string> assetsArchive(p, "--assets-archive", "-aa", "Apk or zip file to serve game assets from, when they are missing from the assets directory", "");
+    argparser::arg<std::string> cpuTopology(p, "--cpu-topology", "-ct", "Cpus reported to the game, either a count or a list like 0-3,6. On linux the launcher is also restricted to them, elsewhere 4 cpus are reported by default", "");
+    argparser::arg<int> benchmarkStartup(p, "--benchmark-startup", "-bs", "Start the game this many times in child processes and report the time to the first frame and until the assets settled, i.e. the first frame after which no asset is opened for 3 s", 0);
+    argparser::arg<std::string> benchmarkOutput(p, "--benchmark-output", "-bo", "Also write the --benchmark-startup results as json to this file", "");
+    argparser::arg<int> benchmarkTimeout(p, "--benchmark-timeout", "-bt", "Seconds after which a --benchmark-startup run is killed and counted as failed", 300);
+    argparser::arg<bool> codeHugePages(p, "--code-huge-pages", "-chp", "Back the code of the game with transparent huge pages to reduce iTLB misses, costs the memory of the code segment (linux only)", false);
+    argparser::arg<std::string> zygoteSocket(p, "--zygote", "-zy", "Load the game once and start a preloaded instance for every data directory sent to this unix socket", "");
+    argparser::arg<std::string> zygoteRequest(p, "--zygote-request", "-zr", "Ask the zygote listening on this unix socket for an instance using --data-dir, prints its pid", "");
+    argparser::arg<std::string> startupProfile(p, "--startup-profile", "-sp", "Write a chrome trace of the startup phases up to the first frame to this file", "");
 
     if(!p.parse(argc, (const char**)argv))
         return 1;
@@ -120,23 +145,38 @@ int main(int argc, char* argv[]) {
         printVersionInfo();
         return 0;
     }
+    if(benchmarkStartup.get() > 0)
+        return StartupBenchmark::run(argc, argv, benchmarkStartup, benchmarkTimeout, benchmarkOutput);
+    if(!startupProfile.get().empty())
+        StartupProfiler::enable(startupProfile);
     options.importFilePath = importFilePath;
     options.sendUri = sendUri;
+    options.assetsArchive = assetsArchive;
+    AssetStats::exitDumpPath = assetStats;
     options.windowWidth = windowWidth;
     options.windowHeight = windowHeight;
     options.graphicsApi = forceEgl.get() ? GraphicsApi::OPENGL_ES2 : GraphicsApi::OPENGL;
     options.useStdinImport = stdinImpt;
-    std::vector<std::string> modDirs;
-    for(size_t i = 0; i < mods.get().length();) {
-        auto r = mods.get().find(',', i);
-        if(r == std::string::npos) {
-            modDirs.push_back(mods.get().substr(i));
-            break;
-        } else {
-            modDirs.push_back(mods.get().substr(i, r - i));
-            i = r + 1;
+    std::vector<std::string> modDirs = splitList(mods);
+    // Linux builds of the game read the real /proc and /sys unless a topology was given
+    std::vector<int> fakeCpus;
+#if defined(__linux__)
+    if(!cpuTopology.get().empty())
+#endif
+    {
+        try {
+            // Elsewhere the game keeps seeing the 4 cpus it always did without --cpu-topology
+            fakeCpus = CpuTopology::parse(cpuTopology.get().empty() ? std::string("4") : cpuTopology.get());
+        } catch(std::exception& e) {
+            Log::error("Launcher", "%s", e.what());
+            return 1;
         }
+#if defined(__linux__)
+        // Threads inherit the affinity, including the ones the game starts later
+        CpuTopology::applyAffinity(fakeCpus);
+#endif
     }
+    options.assetOverlays = splitList(assetOverlays);
 
     FakeEGL::enableTexturePatch = texturePatch.get();
 
@@ -147,6 +187,24 @@ int main(int argc, char* argv[]) {
         PathHelper::setDataDir(dataDir);
     if(!cacheDir.get().empty())
         PathHelper::setCacheDir(cacheDir);
+    if(!zygoteRequest.get().empty()) {
+        try {
+            printf("%d\n", Zygote::request(zygoteRequest, PathHelper::getPrimaryDataDirectory()));
+            return 0;
+        } catch(std::exception& e) {
+            Log::error("Launcher", "%s", e.what());
+            return 1;
+        }
+    }
+#if defined(__i386__) || defined(USE_ARMHF_SUPPORT)
+    if(!zygoteSocket.get().empty()) {
+        // The patches of these builds already need the window manager before the game is loaded
+        Log::error("Launcher", "--zygote isn't supported on this architecture");
+        return 1;
+    }
+#endif
+    // Forked instances can't share the display connection or threads of the zygote
+    bool zygote = !zygoteSocket.get().empty();
 
     Log::info("Launcher", "Version: client %s / manifest %s", CLIENT_GIT_COMMIT_HASH, MANIFEST_GIT_COMMIT_HASH);
 #if defined(__linux__)
@@ -181,6 +239,10 @@ int main(int argc, char* argv[]) {
     }
 #endif
 
+    // Independent startup steps run concurrently, the linker itself isn't thread safe so every step using it holds linkerMutex
+    StartupTaskGraph startup;
+    std::mutex linkerMutex;
+    // Read before the tasks are added, some of them depend on the settings
     if(resetSettings.get()) {
         Log::info("Launcher", "Resetting Launcher Settings File: %s", Settings::getPath().data());
         Settings::save();
@@ -190,82 +252,63 @@ int main(int argc, char* argv[]) {
         Settings::load();
         Log::info("Launcher", "Applied Launcher Settings");
     }
+    // Index the assets while the game library loads, so the first AAssetManager_open doesn't have to
+    std::unique_ptr<FakeAssetManager> assetManager;
+    auto assetManagerTask = startup.add("FakeAssetManager setup", {}, [&]() {
+        try {
+            assetManager = std::make_unique<FakeAssetManager>(PathHelper::getGameDir() + "assets", options.assetsArchive, options.assetOverlays);
+            assetManager->getIndex();
+        } catch(std::exception& e) {
+            Log::warn("Launcher", "Failed to index the assets ahead of time: %s", e.what());
+            assetManager.reset();
+        }
+    });
+    if(Settings::enableAssetPrefetch && !zygote) {
+        startup.add("AssetPrefetch", {assetManagerTask}, [&]() {
+            // Warm the page cache for the assets of the last startup while the game library loads,
+            // through the index so archives and overlays are read from the same place the game will open them
+            if(assetManager)
+                AssetPrefetch::prefetch(assetManager->getIndex());
+            AssetPrefetch::startRecording(std::chrono::seconds(30));
+        });
+    }
 
-    Log::trace("Launcher", "Loading android libraries");
-    linker::init();
-    Log::trace("Launcher", "linker loaded");
-    auto windowManager = GameWindowManager::getManager();
+    // Decide the graphics api and fmod strategy from the dynamic linking info of the game, instead of retrying failed loads
+    std::unique_ptr<GameLibraryProbe> gameProbe;
+    auto probeTask = startup.add("GameLibraryProbe", {}, [&]() {
+        try {
+            gameProbe = std::make_unique<GameLibraryProbe>(PathHelper::findGameFile(std::string("lib/") + MinecraftUtils::getLibraryAbi() + "/libminecraftpe.so"));
+        } catch(std::exception& e) {
+            Log::warn("Launcher", "Failed to probe the game library: %s", e.what());
+            return;
+        }
+        Log::debug("Launcher", "Game library needs %zu libraries, %zu symbols", gameProbe->getNeededLibraries().size(), gameProbe->getImportedSymbols().size());
+        if(options.graphicsApi == GraphicsApi::OPENGL && gameProbe->importsGLES()) {
+            Log::info("Launcher", "The game links against libGLESv2.so (%s), using OpenGL ES", gameProbe->usesRenderDragon() ? "renderdragon" : "old game version");
+            options.graphicsApi = GraphicsApi::OPENGL_ES2;
+        }
+    });
 
-#if !defined(__linux__)
-    // Fake /proc/cpuinfo
-    // https://github.com/pytorch/cpuinfo depends on this file for linux builds
+    auto linkerTask = startup.add("linker::init", {}, []() {
+        Log::trace("Launcher", "Loading android libraries");
+        linker::init();
+        Log::trace("Launcher", "linker loaded");
+    });
+    // Creating the manager connects to the display
+    auto windowManager = zygote ? nullptr : GameWindowManager::getManager();
+
+    // fake proc fs needed for macOS and windows, on linux only with --cpu-topology
     auto fakeproc = PathHelper::getPrimaryDataDirectory() + "proc/";
-    FileUtil::mkdirRecursive(fakeproc);
-    std::ofstream fake_cpuinfo(fakeproc + "/cpuinfo", std::ios::binary | std::ios::trunc);
-    if(fake_cpuinfo.is_open()) {
-#if defined(__i386__) || defined(__x86_64__) 
-        fake_cpuinfo << R"(processor	: 0
-vendor_id	: GenuineIntel
-cpu family	: 6
-model		: 142
-model name	: Intel(R) Core(TM) i7-8550U CPU @ 1.80GHz
-stepping	: 10
-microcode	: 0xffffffff
-cpu MHz		: 1991.999
-cache size	: 8192 KB
-physical id	: 0
-siblings	: 8
-core id		: 0
-cpu cores	: 4
-apicid		: 0
-initial apicid	: 0
-fpu		: yes
-fpu_exception	: yes
-cpuid level	: 22
-wp		: yes
-flags		: fpu vme de pse tsc msr pae mce cx8 apic sep mtrr pge mca cmov pat pse36 clflush mmx fxsr sse sse2 ss ht syscall nx pdpe1gb rdtscp lm constant_tsc rep_good nopl xtopology cpuid pni pclmulqdq vmx ssse3 fma cx16 pcid sse4_1 sse4_2 movbe popcnt aes xsave avx f16c rdrand hypervisor lahf_lm abm 3dnowprefetch invpcid_single pti ssbd ibrs ibpb stibp tpr_shadow vnmi ept vpid ept_ad fsgsbase bmi1 avx2 smep bmi2 erms invpcid rdseed adx smap clflushopt xsaveopt xsavec xgetbv1 xsaves flush_l1d arch_capabilities
-vmx flags	: vnmi invvpid ept_x_only ept_ad ept_1gb tsc_offset vtpr ept vpid unrestricted_guest ept_mode_based_exec
-bugs		: cpu_meltdown spectre_v1 spectre_v2 spec_store_bypass l1tf mds swapgs itlb_multihit srbds
-bogomips	: 3983.99
-clflush size	: 64
-cache_alignment	: 64
-address sizes	: 39 bits physical, 48 bits virtual
-power management:
-
-
-)";
-#elif defined(__arm__) || defined(__aarch64__)
-        fake_cpuinfo << R"(Processor	: AArch64 Processor rev 4 (aarch64)
-processor	: 0
-BogoMIPS	: 38.40
-Features	: fp asimd evtstrm aes pmull sha1 sha2 crc32
-CPU implementer	: 0x51
-CPU architecture: 8
-CPU variant	: 0xa
-CPU part	: 0x801
-CPU revision	: 4
-
-Hardware	: Qualcomm Technologies, Inc MSM8998
-
-)";
-#endif
-        fake_cpuinfo.close();
-    }
-    // cpuinfo for arm64 fails if these are missing...
     auto fakesys = PathHelper::getPrimaryDataDirectory() + "sys/";
-    auto fake_cpu = fakesys + "devices/system/cpu/";
-    FileUtil::mkdirRecursive(fake_cpu);
-    std::ofstream fake_cpu_present(fake_cpu + "/present", std::ios::binary | std::ios::trunc);
-    if(fake_cpu_present.is_open()) {
-        fake_cpu_present << R"(0-3)";
-        fake_cpu_present.close();
-    }
-    std::ofstream fake_cpu_possible(fake_cpu + "/possible", std::ios::binary | std::ios::trunc);
-    if(fake_cpu_possible.is_open()) {
-        fake_cpu_possible << R"(0-3)";
-        fake_cpu_possible.close();
-    }
-#endif
+    auto fakeProcTask = startup.add("create fake proc fs", {}, [&]() {
+        if(fakeCpus.empty())
+            return;
+        try {
+            CpuTopology::writeFakeFiles(fakeCpus, fakeproc, fakesys);
+        } catch(std::exception& e) {
+            Log::warn("Launcher", "Failed to create the fake proc fs: %s", e.what());
+        }
+    });
 
     // Fix saving to internal storage without write access to /data/*
     // TODO research how this path is constructed
@@ -287,111 +330,168 @@ Hardware	: Qualcomm Technologies, Inc MSM8998
     // fake proc fs needed for macOS and windows
     shim::rewrite_filesystem_access.emplace_back("/proc", fakeproc);
     shim::rewrite_filesystem_access.emplace_back("/sys", fakesys);
+#else
+    if(!fakeCpus.empty()) {
+        // Only the cpu files, the rest of /proc and /sys stays the one of the host
+        shim::rewrite_filesystem_access.emplace_back("/proc/cpuinfo", fakeproc + "cpuinfo");
+        shim::rewrite_filesystem_access.emplace_back("/sys/devices/system/cpu/", fakesys + "devices/system/cpu/");
+    }
 #endif
     for(auto&& redir : shim::rewrite_filesystem_access) {
         Log::trace("REDIRECT", "%s to %s", redir.first.data(), redir.second.data());
     }
-    auto libC = MinecraftUtils::getLibCSymbols();
-    ThreadMover::hookLibC(libC);
+    auto libcTask = startup.add("load libc shim", {linkerTask}, [&]() {
+        std::lock_guard<std::mutex> lock(linkerMutex);
+        auto libC = MinecraftUtils::getLibCSymbols();
+        ThreadMover::hookLibC(libC);
 
 #ifdef USE_ARMHF_SUPPORT
-    linker::load_library("ld-android.so", {});
-    android_dlextinfo extinfo;
-    std::vector<mcpelauncher_hook_t> hooks;
-    for(auto&& entry : libC) {
-        hooks.emplace_back(mcpelauncher_hook_t{entry.first.data(), entry.second});
-    }
-    hooks.emplace_back(mcpelauncher_hook_t{nullptr, nullptr});
-    extinfo.flags = ANDROID_DLEXT_MCPELAUNCHER_HOOKS;
-    extinfo.mcpelauncher_hooks = hooks.data();
-    if(linker::dlopen_ext(PathHelper::findDataFile("lib/" + std::string(PathHelper::getAbiDir()) + "/libc.so").c_str(), 0, &extinfo) == nullptr) {
-        Log::error("LAUNCHER", "Failed to load armhf compat libc.so Original Error: %s", linker::dlerror());
-        return 1;
-    }
-    if(linker::dlopen(PathHelper::findDataFile("lib/" + std::string(PathHelper::getAbiDir()) + "/libm.so").c_str(), 0) == nullptr) {
-        Log::error("LAUNCHER", "Failed to load armhf compat libm.so Original Error: %s", linker::dlerror());
-        return 1;
-    }
+        linker::load_library("ld-android.so", {});
+        android_dlextinfo extinfo;
+        std::vector<mcpelauncher_hook_t> hooks;
+        for(auto&& entry : libC) {
+            hooks.emplace_back(mcpelauncher_hook_t{entry.first.data(), entry.second});
+        }
+        hooks.emplace_back(mcpelauncher_hook_t{nullptr, nullptr});
+        extinfo.flags = ANDROID_DLEXT_MCPELAUNCHER_HOOKS;
+        extinfo.mcpelauncher_hooks = hooks.data();
+        if(linker::dlopen_ext(PathHelper::findDataFile("lib/" + std::string(PathHelper::getAbiDir()) + "/libc.so").c_str(), 0, &extinfo) == nullptr) {
+            throw std::runtime_error(std::string("Failed to load armhf compat libc.so Original Error: ") + linker::dlerror());
+        }
+        if(linker::dlopen(PathHelper::findDataFile("lib/" + std::string(PathHelper::getAbiDir()) + "/libm.so").c_str(), 0) == nullptr) {
+            throw std::runtime_error(std::string("Failed to load armhf compat libm.so Original Error: ") + linker::dlerror());
+        }
 #elif defined(__APPLE__) && defined(__aarch64__)
-    MinecraftUtils::loadLibM();
-    android_dlextinfo extinfo;
-    std::vector<mcpelauncher_hook_t> hooks;
-    for(auto&& entry : libC) {
-        hooks.emplace_back(mcpelauncher_hook_t{entry.first.data(), entry.second});
-    }
-    hooks.emplace_back(mcpelauncher_hook_t{nullptr, nullptr});
-    extinfo.flags = ANDROID_DLEXT_MCPELAUNCHER_HOOKS;
-    extinfo.mcpelauncher_hooks = hooks.data();
-    if(linker::dlopen_ext(PathHelper::findDataFile("lib/" + std::string(PathHelper::getAbiDir()) + "/libc.so").c_str(), 0, &extinfo) == nullptr) {
-        Log::error("LAUNCHER", "Failed to load arm64 variadic compat libc.so Original Error: %s", linker::dlerror());
-        return 1;
-    }
-    if(linker::dlopen(PathHelper::findDataFile("lib/" + std::string(PathHelper::getAbiDir()) + "/liblog.so").c_str(), 0) == nullptr) {
-        Log::error("LAUNCHER", "Failed to load arm64 variadic compat liblog.so Original Error: %s", linker::dlerror());
-        return 1;
-    }
+        MinecraftUtils::loadLibM();
+        android_dlextinfo extinfo;
+        std::vector<mcpelauncher_hook_t> hooks;
+        for(auto&& entry : libC) {
+            hooks.emplace_back(mcpelauncher_hook_t{entry.first.data(), entry.second});
+        }
+        hooks.emplace_back(mcpelauncher_hook_t{nullptr, nullptr});
+        extinfo.flags = ANDROID_DLEXT_MCPELAUNCHER_HOOKS;
+        extinfo.mcpelauncher_hooks = hooks.data();
+        if(linker::dlopen_ext(PathHelper::findDataFile("lib/" + std::string(PathHelper::getAbiDir()) + "/libc.so").c_str(), 0, &extinfo) == nullptr) {
+            throw std::runtime_error(std::string("Failed to load arm64 variadic compat libc.so Original Error: ") + linker::dlerror());
+        }
+        if(linker::dlopen(PathHelper::findDataFile("lib/" + std::string(PathHelper::getAbiDir()) + "/liblog.so").c_str(), 0) == nullptr) {
+            throw std::runtime_error(std::string("Failed to load arm64 variadic compat liblog.so Original Error: ") + linker::dlerror());
+        }
 #else
-    linker::load_library("libc.so", libC);
-    MinecraftUtils::loadLibM();
+        linker::load_library("libc.so", libC);
+        MinecraftUtils::loadLibM();
 #endif
-    MinecraftUtils::setupHybris();
-    try {
-        PathHelper::findGameFile(std::string("lib/") + MinecraftUtils::getLibraryAbi() + "/libminecraftpe.so");
-    } catch(std::exception& e) {
-        Log::error("LAUNCHER", "Could not find the game, use the -dg flag to fix this error. Original Error: %s", e.what());
-        return 1;
-    }
-    linker::update_LD_LIBRARY_PATH(PathHelper::findGameFile(std::string("lib/") + MinecraftUtils::getLibraryAbi()).data());
-    if(!disableFmod) {
+    });
+    auto hybrisTask = startup.add("MinecraftUtils::setupHybris", {libcTask}, [&]() {
+        std::lock_guard<std::mutex> lock(linkerMutex);
+        MinecraftUtils::setupHybris();
+        try {
+            PathHelper::findGameFile(std::string("lib/") + MinecraftUtils::getLibraryAbi() + "/libminecraftpe.so");
+        } catch(std::exception& e) {
+            throw std::runtime_error(std::string("Could not find the game, use the -dg flag to fix this error. Original Error: ") + e.what());
+        }
+        linker::update_LD_LIBRARY_PATH(PathHelper::findGameFile(std::string("lib/") + MinecraftUtils::getLibraryAbi()).data());
+    });
+    auto fmodTask = startup.add("MinecraftUtils::loadFMod", {hybrisTask, probeTask}, [&]() {
+        if(disableFmod)
+            return;
+        std::lock_guard<std::mutex> lock(linkerMutex);
         try {
             MinecraftUtils::loadFMod();
         } catch(std::exception& e) {
             Log::info("FMOD", "Failed to load host libfmod: '%s', use pulseaudio/sdl3 backend with android fmod if available", e.what());
+            return;
         }
-    }
-    FakeEGL::setProcAddrFunction((void* (*)(const char*))windowManager->getProcAddrFunc());
-    FakeEGL::installLibrary();
-    if(options.graphicsApi == GraphicsApi::OPENGL_ES2) {
-        // GLFW needs a window to let eglGetProcAddress return symbols
-        FakeLooper::initWindow();
+        if(!gameProbe)
+            return;
+        // e.g. 1.21.30.22 technically require newer fmod, the android fmod of the game has to be used then
+        auto libfmod = linker::dlopen("libfmod.so", 0);
+        if(!libfmod)
+            return;
+        for(auto&& symbol : gameProbe->getImportedSymbolsContaining("FMOD")) {
+            if(!linker::dlsym(libfmod, symbol.c_str())) {
+                Log::info("FMOD", "Host libfmod lacks %s, use the android fmod of the game", symbol.c_str());
+                linker::dlclose(libfmod);
+                linker::unload_library(libfmod);
+                return;
+            }
+        }
+        linker::dlclose(libfmod);
+    });
+    // The window has to be created on the main thread, this overlaps with loading fmod and the android libraries
+    auto windowTask = startup.add("create window and GLES symbols", {hybrisTask, probeTask}, [&]() {
+        if(zygote && options.graphicsApi == GraphicsApi::OPENGL_ES2)
+            throw std::runtime_error("--zygote requires the glcorepatch, with OpenGL ES the window is created before the game is loaded");
+        if(windowManager)
+            FakeEGL::setProcAddrFunction((void* (*)(const char*))windowManager->getProcAddrFunc());
+        {
+            std::lock_guard<std::mutex> lock(linkerMutex);
+            FakeEGL::installLibrary();
+        }
+        if(options.graphicsApi == GraphicsApi::OPENGL_ES2) {
+            // GLFW needs a window to let eglGetProcAddress return symbols
+            FakeLooper::initWindow();
 #ifdef USE_IMGUI
-        gladLoadGLES2Loader(fake_egl::eglGetProcAddress);
+            gladLoadGLES2Loader(fake_egl::eglGetProcAddress);
 #endif
-        MinecraftUtils::setupGLES2Symbols(fake_egl::eglGetProcAddress);
-    } else {
-        // The glcore patch requires an empty library
-        // Otherwise linker has to hide the symbols from dlsym in libminecraftpe.so
-        linker::load_library("libGLESv2.so", {});
-    }
-
-    std::unordered_map<std::string, void*> android_syms;
-    FakeAssetManager::initHybrisHooks(android_syms);
-    FakeInputQueue::initHybrisHooks(android_syms);
-    FakeLooper::initHybrisHooks(android_syms);
-    FakeWindow::initHybrisHooks(android_syms);
-    for(auto s = android_symbols; *s; s++)  // stub missing symbols
-        android_syms.insert({*s, (void*)+[]() { Log::warn("Main", "Android stub called"); }});
-    linker::load_library("libandroid.so", android_syms);
-    CorePatches::loadGameWindowLibrary();
-
-
-    linker::load_library("libmcpelauncher_menu.so", {
-        { "mcpelauncher_addmenu", (void*)mcpelauncher_addmenu },
-        { "mcpelauncher_show_window", (void*)mcpelauncher_show_window },
-        { "mcpelauncher_close_window", (void*)mcpelauncher_close_window },
+            std::lock_guard<std::mutex> lock(linkerMutex);
+            MinecraftUtils::setupGLES2Symbols(fake_egl::eglGetProcAddress);
+        } else {
+            // The glcore patch requires an empty library
+            // Otherwise linker has to hide the symbols from dlsym in libminecraftpe.so
+            std::lock_guard<std::mutex> lock(linkerMutex);
+            linker::load_library("libGLESv2.so", {});
+        }
+    }, true);
+    auto androidTask = startup.add("load android libraries", {hybrisTask}, [&]() {
+        std::unordered_map<std::string, void*> android_syms;
+        FakeAssetManager::initHybrisHooks(android_syms);
+        FakeInputQueue::initHybrisHooks(android_syms);
+        FakeLooper::initHybrisHooks(android_syms);
+        FakeWindow::initHybrisHooks(android_syms);
+        for(auto s = android_symbols; *s; s++)  // stub missing symbols
+            android_syms.insert({*s, (void*)+[]() { Log::warn("Main", "Android stub called"); }});
+        std::lock_guard<std::mutex> lock(linkerMutex);
+        linker::load_library("libandroid.so", android_syms);
+        CorePatches::loadGameWindowLibrary();
+
+
+        linker::load_library("libmcpelauncher_menu.so", {
+            { "mcpelauncher_addmenu", (void*)mcpelauncher_addmenu },
+            { "mcpelauncher_show_window", (void*)mcpelauncher_show_window },
+            { "mcpelauncher_close_window", (void*)mcpelauncher_close_window },
+        });
     });
 
-    ModLoader modLoader;
+    // The mod directories are only scanned once, every phase below loads from this manifest
+    ModManifest mods(linkerMutex);
+    // Without parallelModLoading every mod task runs on the main thread
+    bool modsOnMainThread = !Settings::parallelModLoading;
     if(!freeOnly.get()) {
-        modLoader.loadModsFromDirectory(PathHelper::getPrimaryDataDirectory() + "mods/", true);
-        for(auto&& d : modDirs) {
-            modLoader.loadModsFromDirectory(d, true);
-        }
+        std::vector<std::string> dirs = {PathHelper::getPrimaryDataDirectory() + "mods/"};
+        dirs.insert(dirs.end(), modDirs.begin(), modDirs.end());
+        mods.discover(dirs);
     }
+    auto modsTask = mods.addPreinitTasks(startup, {fmodTask, windowTask, androidTask}, modsOnMainThread);
 
-    Log::trace("Launcher", "Loading Minecraft library");
-    static void* handle = MinecraftUtils::loadMinecraftLib(reinterpret_cast<void*>(&CorePatches::showMousePointer), reinterpret_cast<void*>(&CorePatches::hideMousePointer), reinterpret_cast<void*>(&CorePatches::setFullscreen));
-    if(!handle && options.graphicsApi == GraphicsApi::OPENGL) {
+    static void* handle = nullptr;
+    std::vector<StartupTaskGraph::TaskId> gameDependencies = {modsTask, fakeProcTask};
+    // Keep running the constructors of the game on the main thread
+    startup.add("loadMinecraftLib", gameDependencies, [&]() {
+        Log::trace("Launcher", "Loading Minecraft library");
+        handle = MinecraftUtils::loadMinecraftLib(reinterpret_cast<void*>(&CorePatches::showMousePointer), reinterpret_cast<void*>(&CorePatches::hideMousePointer), reinterpret_cast<void*>(&CorePatches::setFullscreen));
+    }, true);
+
+    try {
+        startup.run();
+    } catch(std::exception& e) {
+        Log::error("LAUNCHER", "%s", e.what());
+        return 1;
+    }
+
+    // Only needed if the probe failed or guessed wrong, every attempt maps and relocates the whole library
+    if(!handle && options.graphicsApi == GraphicsApi::OPENGL && !zygote) {
+        Log::warn("Launcher", "Failed to load the game with the glcorepatch, retrying with OpenGL ES");
         // Old game version or renderdragon
         options.graphicsApi = GraphicsApi::OPENGL_ES2;
         // Unload empty stub library
@@ -406,19 +506,23 @@ Hardware	: Qualcomm Technologies, Inc MSM8998
         gladLoadGLES2Loader(fake_egl::eglGetProcAddress);
 #endif
         // preinit Mods using libGLESv2 can only load now
-        if(!freeOnly.get()) {
-            modLoader.loadModsFromDirectory(PathHelper::getPrimaryDataDirectory() + "mods/", true);
-        }
+        mods.addPreinitTasks(startup, {}, modsOnMainThread);
+        startup.run();
         // Try load the game again
+        StartupProfiler::Scope retryScope("loadMinecraftLib (retry)");
         handle = MinecraftUtils::loadMinecraftLib(reinterpret_cast<void*>(&CorePatches::showMousePointer), reinterpret_cast<void*>(&CorePatches::hideMousePointer), reinterpret_cast<void*>(&CorePatches::setFullscreen));
     }
     if(!handle && !disableFmod) {
         // 1.21.30.22 technically require newer fmod
         auto libfmod = linker::dlopen("libfmod.so", 0);
-        linker::dlclose(libfmod);
-        linker::unload_library(libfmod);
+        if(libfmod) {
+            Log::warn("Launcher", "Failed to load the game with the host libfmod, retrying with the android fmod");
+            linker::dlclose(libfmod);
+            linker::unload_library(libfmod);
+        }
 
         // Try load the game again
+        StartupProfiler::Scope retryScope("loadMinecraftLib (retry)");
         handle = MinecraftUtils::loadMinecraftLib(reinterpret_cast<void*>(&CorePatches::showMousePointer), reinterpret_cast<void*>(&CorePatches::hideMousePointer), reinterpret_cast<void*>(&CorePatches::setFullscreen));
     }
     if(!handle) {
@@ -428,20 +532,19 @@ Hardware	: Qualcomm Technologies, Inc MSM8998
     Log::info("Launcher", "Loaded Minecraft library");
     Log::debug("Launcher", "Minecraft is at offset 0x%" PRIXPTR, (uintptr_t)MinecraftUtils::getLibraryBase(handle));
     base = MinecraftUtils::getLibraryBase(handle);
+    if(!SymbolIndex::build(handle))
+        Log::warn("Launcher", "The game library has no usable hash table, resolving symbols through the linker");
 
-    if(!freeOnly.get()) {
-        modLoader.loadModsFromDirectory(PathHelper::getPrimaryDataDirectory() + "mods/");
-        for(auto&& d : modDirs) {
-            modLoader.loadModsFromDirectory(d);
-        }
-    }
+    mods.addInitTasks(startup, {}, modsOnMainThread);
+    startup.run();
 
     Log::info("Launcher", "Game version: %s", MinecraftVersion::getString().c_str());
 
     Log::info("Launcher", "Applying patches");
+    StartupProfiler::Scope patchScope("install patches");
     if(v8Flags.get().size()) {
         void (*V8SetFlagsFromString)(const char * str, int length);
-        V8SetFlagsFromString = (decltype(V8SetFlagsFromString))linker::dlsym(handle, "_ZN2v82V818SetFlagsFromStringEPKc");
+        V8SetFlagsFromString = (decltype(V8SetFlagsFromString))SymbolIndex::resolve(handle, "_ZN2v82V818SetFlagsFromStringEPKc");
         if(V8SetFlagsFromString) {
             Log::info("V8", "Applying v8-flags %s", v8Flags.get().data());
             V8SetFlagsFromString(v8Flags.get().data(), v8Flags.get().size());
@@ -451,19 +554,19 @@ Hardware	: Qualcomm Technologies, Inc MSM8998
     }
     if(webrtcdebug.get())
     {
-        void (*LogToDebug)(int servity) = (decltype(LogToDebug))linker::dlsym(handle, "_ZN3rtc10LogMessage10LogToDebugENS_15LoggingSeverityE");
+        void (*LogToDebug)(int servity) = (decltype(LogToDebug))SymbolIndex::resolve(handle, "_ZN3rtc10LogMessage10LogToDebugENS_15LoggingSeverityE");
         if(LogToDebug) {
             LogToDebug(0);
         }
-        void (*SetLogToStderr)(bool on) = (decltype(SetLogToStderr))linker::dlsym(handle, "_ZN3rtc10LogMessage14SetLogToStderrEb");
+        void (*SetLogToStderr)(bool on) = (decltype(SetLogToStderr))SymbolIndex::resolve(handle, "_ZN3rtc10LogMessage14SetLogToStderrEb");
         if(SetLogToStderr) {
             SetLogToStderr(true);
         }
     }
-    bool (*isAndroidTrial)() = (decltype(isAndroidTrial))linker::dlsym(handle, "Java_com_mojang_minecraftpe_MainActivity_isAndroidTrial");
-    bool (*isAndroidChromebook)() = (decltype(isAndroidChromebook))linker::dlsym(handle, "Java_com_mojang_minecraftpe_MainActivity_isAndroidChromebook");
-    bool (*isAndroidAmazon)() = (decltype(isAndroidAmazon))linker::dlsym(handle, "Java_com_mojang_minecraftpe_MainActivity_isAndroidAmazon");
-    bool (*isEduMode)() = (decltype(isEduMode))linker::dlsym(handle, "Java_com_mojang_minecraftpe_MainActivity_isEduMode");
+    bool (*isAndroidTrial)() = (decltype(isAndroidTrial))SymbolIndex::resolve(handle, "Java_com_mojang_minecraftpe_MainActivity_isAndroidTrial");
+    bool (*isAndroidChromebook)() = (decltype(isAndroidChromebook))SymbolIndex::resolve(handle, "Java_com_mojang_minecraftpe_MainActivity_isAndroidChromebook");
+    bool (*isAndroidAmazon)() = (decltype(isAndroidAmazon))SymbolIndex::resolve(handle, "Java_com_mojang_minecraftpe_MainActivity_isAndroidAmazon");
+    bool (*isEduMode)() = (decltype(isEduMode))SymbolIndex::resolve(handle, "Java_com_mojang_minecraftpe_MainActivity_isEduMode");
     
     if(isAndroidTrial && isAndroidTrial()) {
         Log::info("Launcher", "Detected Trial build");
@@ -482,8 +585,15 @@ Hardware	: Qualcomm Technologies, Inc MSM8998
         return 1;
     }
                 
-    SymbolsHelper::initSymbols(handle);
-    CorePatches::install(handle);
+    PatchSiteCache::load(handle, PathHelper::findGameFile(std::string("lib/") + MinecraftUtils::getLibraryAbi() + "/libminecraftpe.so"), gameProbe ? gameProbe->getBuildId() : std::string());
+    {
+        StartupProfiler::Scope symbolsScope("SymbolsHelper::initSymbols");
+        SymbolsHelper::initSymbols(handle);
+    }
+    {
+        StartupProfiler::Scope coreScope("CorePatches::install");
+        CorePatches::install(handle);
+    }
 #ifdef __i386__
     TexelAAPatch::install(handle);
     HbuiPatch::install(handle);
@@ -491,6 +601,7 @@ Hardware	: Qualcomm Technologies, Inc MSM8998
     ShaderErrorPatch::install(handle);
 #endif
     if(options.graphicsApi == GraphicsApi::OPENGL) {
+        StartupProfiler::Scope glCoreScope("GLCorePatch::install");
         try {
             GLCorePatch::install(handle);
         } catch(const std::exception& ex) {
@@ -498,17 +609,60 @@ Hardware	: Qualcomm Technologies, Inc MSM8998
             options.graphicsApi = GraphicsApi::OPENGL_ES2;
         }
     }
+    PatchSiteCache::save();
+
+    patchScope.end();
 
     Log::info("Launcher", "Initializing JNI");
     JniSupport support;
+    support.setAssetManager(std::move(assetManager));
     FakeLooper::setJniSupport(&support);
-    support.registerMinecraftNatives(+[](const char* sym) {
-        return linker::dlsym(handle, sym);
+    StartupProfiler::Scope nativesScope("JniSupport::registerMinecraftNatives");
+    support.registerMinecraftNatives(+[](std::vector<std::string> const& names, std::vector<void*>& symbols) {
+        SymbolIndex::resolveAll(handle, names, symbols);
     });
+    nativesScope.end();
+    SymbolIndex::logStats();
+
+    if(codeHugePages.get()) {
+        // After the patches and mods, changing the protection of a part of a huge page later splits it again
+        StartupProfiler::Scope hugePagesScope("CodeHugePages::apply");
+        CodeHugePages::apply(handle);
+    }
+
+    if(zygote) {
+        if(options.graphicsApi != GraphicsApi::OPENGL) {
+            Log::error("Launcher", "--zygote requires the glcorepatch");
+            return 1;
+        }
+        std::string instanceDataDir;
+        try {
+            instanceDataDir = Zygote::run(zygoteSocket);
+        } catch(std::exception& e) {
+            Log::error("Launcher", "%s", e.what());
+            return 1;
+        }
+        // From here on this is a forked instance, everything above is shared copy on write with the zygote
+        auto zygoteDataDir = PathHelper::getPrimaryDataDirectory();
+        PathHelper::setDataDir(instanceDataDir);
+        defaultDataDir = PathHelper::getPrimaryDataDirectory();
+        FileUtil::mkdirRecursive(defaultDataDir);
+        for(auto&& redir : shim::rewrite_filesystem_access) {
+            if(redir.second == zygoteDataDir)
+                redir.second = defaultDataDir;
+        }
+        Log::info("Launcher", "Zygote instance %d using %s", (int)getpid(), defaultDataDir.c_str());
+        Settings::load();
+        loadGameOptions();
+        windowManager = GameWindowManager::getManager();
+        FakeEGL::setProcAddrFunction((void* (*)(const char*))windowManager->getProcAddrFunc());
+    }
+
     std::thread startThread([&support]() {
-        support.startGame((ANativeActivity_createFunc*)linker::dlsym(handle, "ANativeActivity_onCreate"),
-                          linker::dlsym(handle, "stbi_load_from_memory"),
-                          linker::dlsym(handle, "stbi_image_free"));
+        StartupProfiler::setThreadName("startGame");
+        support.startGame((ANativeActivity_createFunc*)SymbolIndex::resolve(handle, "ANativeActivity_onCreate"),
+                          SymbolIndex::resolve(handle, "stbi_load_from_memory"),
+                          SymbolIndex::resolve(handle, "stbi_image_free"));
         linker::dlclose(handle);
     });
     startThread.detach();
@@ -524,6 +678,7 @@ Hardware	: Qualcomm Technologies, Inc MSM8998
     Log::info("Launcher", "Executing main thread");
     ThreadMover::executeMainThread();
     support.setLooperRunning(false);
+    AssetStats::dumpOnExit();
 
     //    XboxLivePatches::workaroundShutdownFreeze(handle);
     XboxLiveHelper::getInstance().shutdown();
@@ -549,6 +704,21 @@ void printVersionInfo() {
     printf("MSA daemon path: %s\n", XboxLiveHelper::findMsa().c_str());
 }
 
+std::vector<std::string> splitList(std::string const& list) {
+    std::vector<std::string> ret;
+    for(size_t i = 0; i < list.length();) {
+        auto r = list.find(',', i);
+        if(r == std::string::npos) {
+            ret.push_back(list.substr(i));
+            break;
+        } else {
+            ret.push_back(list.substr(i, r - i));
+            i = r + 1;
+        }
+    }
+    return ret;
+}
+
 void loadGameOptions() {
     properties::property_list properties(':');
     properties::property<int> leftKey(properties, "keyboard_type_0_key.left", 'A');
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <game_window.h>
+#include <string>
+#include <vector>
 
 struct LauncherOptions {
     int windowWidth, windowHeight;
@@ -8,5 +10,7 @@ struct LauncherOptions {
     GraphicsApi graphicsApi;
     std::string importFilePath;
     std::string sendUri;
+    std::string assetsArchive;
+    std::vector<std::string> assetOverlays;
 };
 extern LauncherOptions options;
@@ -0,0 +1,200 @@
+#include "mod_manifest.h"
+#include "game_library_probe.h"
+#include <dirent.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <log.h>
+#include <mcpelauncher/linker.h>
+
+static const char *TAG = "ModManifest";
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ModManifest::discover(std::vector<std::string> const &directories) {
+    auto start = std::chrono::steady_clock::now();
+    mods.clear();
+    std::unordered_map<std::string, size_t> byName;
+    std::vector<std::vector<std::string>> neededLibraries;
+    for(auto dir : directories) {
+        if(dir.empty())
+            continue;
+        if(dir.back() != '/')
+            dir += '/';
+        DIR *d = opendir(dir.c_str());
+        if(d == nullptr)
+            continue;
+        std::vector<std::string> names;
+        while(dirent *ent = readdir(d)) {
+            std::string name = ent->d_name;
+            if(name[0] == '.' || name.size() < 4 || name.compare(name.size() - 3, 3, ".so") != 0)
+                continue;
+            names.push_back(std::move(name));
+        }
+        closedir(d);
+        // Same order as before, independent of the directory order of the filesystem
+        std::sort(names.begin(), names.end());
+
+        for(auto &&name : names) {
+            if(byName.count(name)) {
+                Log::warn(TAG, "Ignoring %s%s, a mod with the same name was found before", dir.c_str(), name.c_str());
+                continue;
+            }
+            Mod mod;
+            mod.name = name;
+            mod.path = dir + name;
+            std::vector<std::string> needed;
+            try {
+                GameLibraryProbe probe(mod.path, {"mod_preinit", "mod_init"});
+                mod.hasPreinit = probe.exports("mod_preinit");
+                mod.hasInit = probe.exports("mod_init");
+                needed = probe.getNeededLibraries();
+            } catch(std::exception &e) {
+                // Still let the linker try, without dependency information and preinit
+                Log::warn(TAG, "Failed to inspect mod %s: %s", mod.path.c_str(), e.what());
+                mod.hasInit = true;
+            }
+            byName[name] = mods.size();
+            mods.push_back(std::move(mod));
+            neededLibraries.push_back(std::move(needed));
+        }
+    }
+    for(size_t i = 0; i < mods.size(); i++) {
+        for(auto &&library : neededLibraries[i]) {
+            auto it = byName.find(library);
+            if(it != byName.end() && it->second != i)
+                mods[i].dependencies.push_back(it->second);
+        }
+    }
+    Log::info(TAG, "Found %zu mods in %.1f ms", mods.size(), millisecondsSince(start));
+}
+
+void ModManifest::addDependencies(size_t index, std::vector<bool> &selected, std::vector<bool> &visiting) const {
+    if(selected[index])
+        return;
+    selected[index] = true;
+    visiting[index] = true;
+    for(auto dependency : mods[index].dependencies) {
+        if(visiting[dependency]) {
+            Log::error(TAG, "Found a dependency cycle between %s and %s", mods[index].name.c_str(), mods[dependency].name.c_str());
+            continue;
+        }
+        addDependencies(dependency, selected, visiting);
+    }
+    visiting[index] = false;
+}
+
+void ModManifest::load(size_t index) {
+    auto &mod = mods[index];
+    std::lock_guard<std::mutex> lock(linkerMutex);
+    if(mod.handle != nullptr)
+        return;
+    auto start = std::chrono::steady_clock::now();
+    mod.handle = linker::dlopen(mod.path.c_str(), 0);
+    if(mod.handle == nullptr)
+        throw std::runtime_error("Failed to load mod " + mod.path + ": " + linker::dlerror());
+    mod.loadMs = millisecondsSince(start);
+}
+
+void ModManifest::runInit(size_t index, bool preinit) {
+    auto &mod = mods[index];
+    // Init functions resolve symbols and patch the game, keep them away from the linker and from each other
+    std::lock_guard<std::mutex> lock(linkerMutex);
+    void (*initFunc)() = nullptr;
+    if(preinit && mod.hasPreinit) {
+        initFunc = (void (*)())linker::dlsym(mod.handle, "mod_preinit");
+    } else if(!preinit && !mod.initialized) {
+        mod.initialized = true;
+        if(mod.hasInit)
+            initFunc = (void (*)())linker::dlsym(mod.handle, "mod_init");
+    }
+    double initMs = 0;
+    if(initFunc) {
+        auto start = std::chrono::steady_clock::now();
+        initFunc();
+        initMs = millisecondsSince(start);
+        mod.initMs += initMs;
+    }
+    Log::info(TAG, "Loaded mod %s in %.1f ms, %s took %.1f ms", mod.name.c_str(), mod.loadMs, preinit ? "mod_preinit" : "mod_init", initMs);
+}
+
+StartupTaskGraph::TaskId ModManifest::addPhase(StartupTaskGraph &graph, std::vector<StartupTaskGraph::TaskId> const &after, std::vector<bool> const &selected, bool preinit, bool mainThread) {
+    std::vector<StartupTaskGraph::TaskId> tasks(mods.size());
+    std::vector<int> state(mods.size());  // 0 not added, 1 adding, 2 added
+    // Dependencies come before the mods using them
+    auto order = std::make_shared<std::vector<size_t>>();
+    std::vector<StartupTaskGraph::TaskId> loadTasks = after;
+    // The graph wants the dependencies of a task to be added before it
+    std::function<void(size_t)> addTask = [&](size_t index) {
+        if(state[index] != 0)
+            return;
+        state[index] = 1;
+        std::vector<StartupTaskGraph::TaskId> dependencies = after;
+        std::vector<size_t> modDependencies;
+        for(auto dependency : mods[index].dependencies) {
+            if(!selected[dependency] || state[dependency] == 1)
+                continue;
+            addTask(dependency);
+            dependencies.push_back(tasks[dependency]);
+            modDependencies.push_back(dependency);
+        }
+        // Failures don't reach the graph, it would skip the init functions of the other mods as well
+        tasks[index] = graph.add(mods[index].name.c_str(), dependencies, [this, index, modDependencies]() {
+            for(auto dependency : modDependencies) {
+                if(mods[dependency].handle == nullptr) {
+                    Log::error(TAG, "Not loading mod %s, it depends on %s which failed to load", mods[index].name.c_str(), mods[dependency].name.c_str());
+                    return;
+                }
+            }
+            try {
+                load(index);
+            } catch(std::exception &e) {
+                Log::error(TAG, "%s", e.what());
+            }
+        }, mainThread);
+        state[index] = 2;
+        order->push_back(index);
+        loadTasks.push_back(tasks[index]);
+    };
+    for(size_t i = 0; i < mods.size(); i++) {
+        if(selected[i])
+            addTask(i);
+    }
+    return graph.add(preinit ? "ModManifest::preinit" : "ModManifest::init", loadTasks, [this, order, preinit]() {
+        for(auto index : *order) {
+            if(mods[index].handle == nullptr)
+                continue;
+            try {
+                runInit(index, preinit);
+            } catch(std::exception &e) {
+                Log::error(TAG, "%s of mod %s failed: %s", preinit ? "mod_preinit" : "mod_init", mods[index].name.c_str(), e.what());
+            }
+        }
+    }, mainThread);
+}
+
+StartupTaskGraph::TaskId ModManifest::addPreinitTasks(StartupTaskGraph &graph, std::vector<StartupTaskGraph::TaskId> const &after, bool mainThread) {
+    std::vector<bool> selected(mods.size()), visiting(mods.size());
+    for(size_t i = 0; i < mods.size(); i++) {
+        if(mods[i].hasPreinit && mods[i].handle == nullptr)
+            addDependencies(i, selected, visiting);
+    }
+    // Dependencies which loaded before don't need another task
+    for(size_t i = 0; i < mods.size(); i++) {
+        if(mods[i].handle != nullptr)
+            selected[i] = false;
+    }
+    return addPhase(graph, after, selected, true, mainThread);
+}
+
+StartupTaskGraph::TaskId ModManifest::addInitTasks(StartupTaskGraph &graph, std::vector<StartupTaskGraph::TaskId> const &after, bool mainThread) {
+    std::vector<bool> selected(mods.size());
+    for(size_t i = 0; i < mods.size(); i++)
+        selected[i] = !mods[i].initialized;
+    return addPhase(graph, after, selected, false, mainThread);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "startup_task_graph.h"
+
+// Scans the mod directories once and loads the mods of every phase from that list as tasks of the startup graph,
+// mods which don't depend on each other are loaded concurrently, their init functions run one at a time in dependency order
+class ModManifest {
+public:
+    struct Mod {
+        // File name, a mod with the same name in a later directory is ignored
+        std::string name;
+        std::string path;
+        // Indices of the mods this one links against, they have to be loaded first
+        std::vector<size_t> dependencies;
+        bool hasPreinit = false;
+        bool hasInit = false;
+        void *handle = nullptr;
+        bool initialized = false;
+        double loadMs = 0;
+        double initMs = 0;
+    };
+
+private:
+    std::vector<Mod> mods;
+    // The linker isn't thread safe, shared with the other startup steps using it
+    std::mutex &linkerMutex;
+
+    void addDependencies(size_t index, std::vector<bool> &selected, std::vector<bool> &visiting) const;
+
+    void load(size_t index);
+
+    void runInit(size_t index, bool preinit);
+
+    StartupTaskGraph::TaskId addPhase(StartupTaskGraph &graph, std::vector<StartupTaskGraph::TaskId> const &after, std::vector<bool> const &selected, bool preinit, bool mainThread);
+
+public:
+    explicit ModManifest(std::mutex &linkerMutex) : linkerMutex(linkerMutex) {}
+
+    // Mods are identified by their file name, directories are searched in order
+    void discover(std::vector<std::string> const &directories);
+
+    // Adds a task loading each mod exporting mod_preinit and the mods it depends on, mods which failed to load before are retried.
+    // The tasks start after the tasks in after, a mod which failed to load only skips the mods depending on it.
+    // Returns the task calling the init functions, mainThread keeps every task of the phase on the thread running the graph
+    StartupTaskGraph::TaskId addPreinitTasks(StartupTaskGraph &graph, std::vector<StartupTaskGraph::TaskId> const &after, bool mainThread);
+
+    // Same for the remaining mods, the returned task calls mod_init of every loaded mod
+    StartupTaskGraph::TaskId addInitTasks(StartupTaskGraph &graph, std::vector<StartupTaskGraph::TaskId> const &after, bool mainThread);
+
+    std::vector<Mod> const &getMods() const { return mods; }
+};
@@ -0,0 +1,134 @@
+#include "patch_site_cache.h"
+#include "loaded_segments.h"
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <log.h>
+#include <mcpelauncher/minecraft_utils.h>
+#include <mcpelauncher/path_helper.h>
+
+std::string PatchSiteCache::key;
+uintptr_t PatchSiteCache::base;
+std::vector<std::pair<size_t, size_t>> PatchSiteCache::codeRanges;
+std::unordered_map<std::string, PatchSiteCache::Site> PatchSiteCache::sites;
+bool PatchSiteCache::dirty;
+
+static std::string toHex(const unsigned char *data, size_t size) {
+    static const char hex[] = "0123456789abcdef";
+    std::string ret;
+    for(size_t i = 0; i < size; i++) {
+        ret += hex[data[i] >> 4];
+        ret += hex[data[i] & 0xF];
+    }
+    return ret;
+}
+
+static bool fromHex(std::string const &str, std::vector<unsigned char> &out) {
+    if(str.size() % 2)
+        return false;
+    out.clear();
+    for(size_t i = 0; i < str.size(); i += 2) {
+        char *end;
+        char byte[3] = {str[i], str[i + 1], 0};
+        out.push_back((unsigned char)strtoul(byte, &end, 16));
+        if(*end)
+            return false;
+    }
+    return true;
+}
+
+std::string PatchSiteCache::getPath() {
+    return PathHelper::getPrimaryDataDirectory() + "patch-site-cache.txt";
+}
+
+void PatchSiteCache::load(void *handle, std::string const &libraryPath, std::string const &buildId) {
+    base = (uintptr_t)MinecraftUtils::getLibraryBase(handle);
+    codeRanges.clear();
+    for(auto &&segment : getLoadedSegments(handle)) {
+        if(segment.isCode())
+            codeRanges.emplace_back((size_t)((uintptr_t)segment.start - base), (size_t)((uintptr_t)segment.start - base + segment.size));
+    }
+    sites.clear();
+    dirty = false;
+    key = buildId;
+    if(key.empty()) {
+        struct stat st;
+        if(stat(libraryPath.c_str(), &st) != 0)
+            return;
+        key = "size-" + std::to_string((long long)st.st_size) + "-mtime-" + std::to_string((long long)st.st_mtime);
+    }
+
+    // First line is the key, then one "name offset bytes" line per site
+    std::ifstream file(getPath());
+    std::string line;
+    if(!std::getline(file, line) || line != key)
+        return;
+    while(std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name, bytes;
+        Site site;
+        if(!(fields >> name >> std::hex >> site.offset >> bytes) || !fromHex(bytes, site.bytes))
+            continue;
+        sites[name] = std::move(site);
+    }
+    Log::trace("PatchSiteCache", "Loaded %zu patch sites for %s", sites.size(), key.c_str());
+}
+
+void *PatchSiteCache::find(std::string const &name, size_t validateLength) {
+    auto it = sites.find(name);
+    if(it == sites.end() || it->second.bytes.size() != validateLength)
+        return nullptr;
+    // A corrupt or edited cache file must not make us read outside of the game code
+    size_t offset = it->second.offset;
+    bool inCode = false;
+    for(auto &&range : codeRanges)
+        inCode = inCode || (offset >= range.first && offset <= range.second && validateLength <= range.second - offset);
+    if(!inCode) {
+        Log::warn("PatchSiteCache", "Cached site of %s is outside of the game code, scanning again", name.c_str());
+        sites.erase(it);
+        dirty = true;
+        return nullptr;
+    }
+    auto ptr = (void *)(base + offset);
+    if(memcmp(ptr, it->second.bytes.data(), validateLength) != 0) {
+        Log::warn("PatchSiteCache", "Cached site of %s doesn't match, scanning again", name.c_str());
+        sites.erase(it);
+        dirty = true;
+        return nullptr;
+    }
+    return ptr;
+}
+
+void PatchSiteCache::store(std::string const &name, void *ptr, size_t validateLength) {
+    if(key.empty())
+        return;
+    Site site;
+    site.offset = (uintptr_t)ptr - base;
+    site.bytes.assign((unsigned char *)ptr, (unsigned char *)ptr + validateLength);
+    auto it = sites.find(name);
+    if(it != sites.end() && it->second.offset == site.offset && it->second.bytes == site.bytes)
+        return;
+    sites[name] = std::move(site);
+    dirty = true;
+}
+
+void PatchSiteCache::save() {
+    if(!dirty)
+        return;
+    auto path = getPath();
+    {
+        std::ofstream file(path + ".tmp", std::ios::binary | std::ios::trunc);
+        if(!file.is_open()) {
+            Log::warn("PatchSiteCache", "Failed to write %s", path.c_str());
+            return;
+        }
+        file << key << '\n';
+        for(auto &&site : sites)
+            file << site.first << ' ' << std::hex << site.second.offset << std::dec << ' ' << toHex(site.second.bytes.data(), site.second.bytes.size()) << '\n';
+    }
+    if(rename((path + ".tmp").c_str(), path.c_str()) != 0)
+        Log::warn("PatchSiteCache", "Failed to replace %s", path.c_str());
+    dirty = false;
+}
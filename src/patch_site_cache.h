@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Remembers where the pattern based patches matched, keyed by the build-id of the game library,
+// so later launches of the same build can skip scanning the game image
+class PatchSiteCache {
+private:
+    struct Site {
+        size_t offset;
+        // Original bytes at the site, checked before a cached site is used
+        std::vector<unsigned char> bytes;
+    };
+
+    static std::string key;
+    static uintptr_t base;
+    // Offsets of the executable segments of the library, cached sites have to lie within one of them
+    static std::vector<std::pair<size_t, size_t>> codeRanges;
+    static std::unordered_map<std::string, Site> sites;
+    static bool dirty;
+
+public:
+    static std::string getPath();
+
+    // buildId may be empty, the size and modification time of the library are used then
+    static void load(void *handle, std::string const &libraryPath, std::string const &buildId);
+
+    // Address of the site if it was cached for this build and still contains the same validateLength bytes
+    static void *find(std::string const &name, size_t validateLength);
+
+    // Call before patching the site, so the original bytes get recorded
+    static void store(std::string const &name, void *ptr, size_t validateLength);
+
+    static void save();
+};
@@ -0,0 +1,273 @@
+#include "pattern_scanner.h"
+#include "loaded_segments.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <log.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#define PATTERN_SCANNER_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define PATTERN_SCANNER_NEON
+#endif
+
+// Lower is rarer in x86 and arm code, the anchor avoids padding and the most common opcodes
+static int getByteFrequency(unsigned char b) {
+    switch(b) {
+    case 0x00:
+    case 0xFF:
+        return 3;
+    case 0x0F:
+    case 0x24:
+    case 0x48:
+    case 0x83:
+    case 0x89:
+    case 0x8B:
+    case 0x90:
+    case 0xCC:
+    case 0xE8:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static unsigned countTrailingZeros(uint32_t v) {
+    return (unsigned)__builtin_ctz(v);
+}
+
+size_t PatternScanner::add(std::string const &pattern) {
+    Pattern p;
+    for(size_t i = 0; i < pattern.size();) {
+        if(pattern[i] == ' ') {
+            i++;
+            continue;
+        }
+        if(i + 1 >= pattern.size())
+            throw std::invalid_argument("Truncated byte in pattern: " + pattern);
+        if(pattern[i] == '?' && pattern[i + 1] == '?') {
+            p.bytes.push_back(0);
+            p.mask.push_back(0);
+        } else {
+            char hex[3] = {pattern[i], pattern[i + 1], 0};
+            char *end;
+            unsigned long value = strtoul(hex, &end, 16);
+            if(*end)
+                throw std::invalid_argument("Invalid byte in pattern: " + pattern);
+            p.bytes.push_back((unsigned char)value);
+            p.mask.push_back(0xFF);
+        }
+        i += 2;
+    }
+    if(p.bytes.empty() || std::find(p.mask.begin(), p.mask.end(), 0xFF) == p.mask.end())
+        throw std::invalid_argument("Pattern has no fixed bytes: " + pattern);
+
+    // Prefer a pair of fixed bytes, a single fixed byte has to do for patterns without one
+    int best = 1 << 30;
+    p.anchorPair = false;
+    for(size_t i = 0; i < p.bytes.size(); i++) {
+        if(!p.mask[i])
+            continue;
+        bool pair = i + 1 < p.bytes.size() && p.mask[i + 1];
+        int score = getByteFrequency(p.bytes[i]) + (pair ? getByteFrequency(p.bytes[i + 1]) : 16);
+        if(score < best) {
+            best = score;
+            p.anchor = i;
+            p.anchorPair = pair;
+        }
+    }
+    patterns.push_back(std::move(p));
+    return patterns.size() - 1;
+}
+
+bool PatternScanner::matches(Pattern const &pattern, const unsigned char *data, size_t size, size_t anchorPos, size_t &start) const {
+    if(anchorPos < pattern.anchor)
+        return false;
+    start = anchorPos - pattern.anchor;
+    if(pattern.bytes.size() > size - start)
+        return false;
+    for(size_t i = 0; i < pattern.bytes.size(); i++) {
+        if((data[start + i] & pattern.mask[i]) != pattern.bytes[i])
+            return false;
+    }
+    return true;
+}
+
+void PatternScanner::scanScalar(const unsigned char *data, size_t size, size_t from, std::vector<Match> &out) const {
+    for(size_t pos = from; pos < size; pos++) {
+        for(size_t i = 0; i < patterns.size(); i++) {
+            auto &p = patterns[i];
+            if(data[pos] != p.bytes[p.anchor] || (p.anchorPair && (pos + 1 >= size || data[pos + 1] != p.bytes[p.anchor + 1])))
+                continue;
+            size_t start;
+            if(matches(p, data, size, pos, start))
+                out.push_back({i, start});
+        }
+    }
+}
+
+#ifdef PATTERN_SCANNER_X86
+__attribute__((target("sse2"))) size_t PatternScanner::scanSSE2(const unsigned char *data, size_t size, std::vector<Match> &out) const {
+    size_t pos = 0;
+    for(; pos + 17 <= size; pos += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(data + pos));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(data + pos + 1));
+        for(size_t i = 0; i < patterns.size(); i++) {
+            auto &p = patterns[i];
+            __m128i eq = _mm_cmpeq_epi8(v0, _mm_set1_epi8((char)p.bytes[p.anchor]));
+            if(p.anchorPair)
+                eq = _mm_and_si128(eq, _mm_cmpeq_epi8(v1, _mm_set1_epi8((char)p.bytes[p.anchor + 1])));
+            for(uint32_t bits = (uint32_t)_mm_movemask_epi8(eq); bits; bits &= bits - 1) {
+                size_t start;
+                if(matches(p, data, size, pos + countTrailingZeros(bits), start))
+                    out.push_back({i, start});
+            }
+        }
+    }
+    return pos;
+}
+
+__attribute__((target("avx2"))) size_t PatternScanner::scanAVX2(const unsigned char *data, size_t size, std::vector<Match> &out) const {
+    size_t pos = 0;
+    for(; pos + 33 <= size; pos += 32) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(data + pos));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(data + pos + 1));
+        for(size_t i = 0; i < patterns.size(); i++) {
+            auto &p = patterns[i];
+            __m256i eq = _mm256_cmpeq_epi8(v0, _mm256_set1_epi8((char)p.bytes[p.anchor]));
+            if(p.anchorPair)
+                eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(v1, _mm256_set1_epi8((char)p.bytes[p.anchor + 1])));
+            for(uint32_t bits = (uint32_t)_mm256_movemask_epi8(eq); bits; bits &= bits - 1) {
+                size_t start;
+                if(matches(p, data, size, pos + countTrailingZeros(bits), start))
+                    out.push_back({i, start});
+            }
+        }
+    }
+    return pos;
+}
+#else
+size_t PatternScanner::scanSSE2(const unsigned char * /*data*/, size_t /*size*/, std::vector<Match> & /*out*/) const {
+    return 0;
+}
+
+size_t PatternScanner::scanAVX2(const unsigned char * /*data*/, size_t /*size*/, std::vector<Match> & /*out*/) const {
+    return 0;
+}
+#endif
+
+#ifdef PATTERN_SCANNER_NEON
+size_t PatternScanner::scanNEON(const unsigned char *data, size_t size, std::vector<Match> &out) const {
+    size_t pos = 0;
+    for(; pos + 17 <= size; pos += 16) {
+        uint8x16_t v0 = vld1q_u8(data + pos);
+        uint8x16_t v1 = vld1q_u8(data + pos + 1);
+        for(size_t i = 0; i < patterns.size(); i++) {
+            auto &p = patterns[i];
+            uint8x16_t eq = vceqq_u8(v0, vdupq_n_u8(p.bytes[p.anchor]));
+            if(p.anchorPair)
+                eq = vandq_u8(eq, vceqq_u8(v1, vdupq_n_u8(p.bytes[p.anchor + 1])));
+            if(vmaxvq_u8(eq) == 0)
+                continue;
+            unsigned char lanes[16];
+            vst1q_u8(lanes, eq);
+            for(size_t lane = 0; lane < 16; lane++) {
+                size_t start;
+                if(lanes[lane] && matches(p, data, size, pos + lane, start))
+                    out.push_back({i, start});
+            }
+        }
+    }
+    return pos;
+}
+#else
+size_t PatternScanner::scanNEON(const unsigned char * /*data*/, size_t /*size*/, std::vector<Match> & /*out*/) const {
+    return 0;
+}
+#endif
+
+bool PatternScanner::isSupported(Implementation implementation) {
+    switch(implementation) {
+    case Implementation::AUTO:
+    case Implementation::SCALAR:
+        return true;
+#ifdef PATTERN_SCANNER_X86
+    case Implementation::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case Implementation::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef PATTERN_SCANNER_NEON
+    case Implementation::NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+PatternScanner::Implementation PatternScanner::getBestImplementation() {
+    for(auto implementation : {Implementation::AVX2, Implementation::SSE2, Implementation::NEON}) {
+        if(isSupported(implementation))
+            return implementation;
+    }
+    return Implementation::SCALAR;
+}
+
+const char *PatternScanner::getName(Implementation implementation) {
+    switch(implementation) {
+    case Implementation::AUTO:
+        return "auto";
+    case Implementation::SCALAR:
+        return "scalar";
+    case Implementation::SSE2:
+        return "sse2";
+    case Implementation::AVX2:
+        return "avx2";
+    case Implementation::NEON:
+        return "neon";
+    }
+    return "unknown";
+}
+
+std::vector<PatternScanner::Match> PatternScanner::scan(const unsigned char *data, size_t size, Implementation implementation) const {
+    if(implementation == Implementation::AUTO)
+        implementation = getBestImplementation();
+    if(!isSupported(implementation))
+        throw std::invalid_argument(std::string("The cpu doesn't support ") + getName(implementation));
+    std::vector<Match> out;
+    if(patterns.empty())
+        return out;
+    size_t pos = 0;
+    if(implementation == Implementation::SSE2)
+        pos = scanSSE2(data, size, out);
+    else if(implementation == Implementation::AVX2)
+        pos = scanAVX2(data, size, out);
+    else if(implementation == Implementation::NEON)
+        pos = scanNEON(data, size, out);
+    scanScalar(data, size, pos, out);
+    std::sort(out.begin(), out.end(), [](Match const &a, Match const &b) {
+        return a.offset != b.offset ? a.offset < b.offset : a.pattern < b.pattern;
+    });
+    return out;
+}
+
+std::vector<void *> PatternScanner::findFirst(void *handle) const {
+    std::vector<void *> ret(patterns.size(), nullptr);
+    auto segments = getLoadedSegments(handle);
+    if(segments.empty()) {
+        Log::error("PatternScanner", "The library base doesn't point to an ELF header");
+        return ret;
+    }
+    for(auto &&segment : segments) {
+        if(!segment.isCode())
+            continue;
+        for(auto &&match : scan(segment.start, segment.size)) {
+            if(!ret[match.pattern])
+                ret[match.pattern] = (void *)(segment.start + match.offset);
+        }
+    }
+    return ret;
+}
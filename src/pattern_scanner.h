@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Matches many masked byte patterns in a single vectorized pass, instead of one PatchUtils::patternSearch pass per pattern
+class PatternScanner {
+public:
+    enum class Implementation {
+        AUTO,
+        SCALAR,
+        SSE2,
+        AVX2,
+        NEON,
+    };
+
+    struct Match {
+        size_t pattern;
+        size_t offset;
+    };
+
+private:
+    struct Pattern {
+        // bytes are already masked, mask is 0xFF for fixed and 0x00 for wildcard bytes
+        std::vector<unsigned char> bytes;
+        std::vector<unsigned char> mask;
+        // Offset of the two fixed bytes every candidate position is filtered with
+        size_t anchor;
+        bool anchorPair;
+    };
+
+    std::vector<Pattern> patterns;
+
+    bool matches(Pattern const &pattern, const unsigned char *data, size_t size, size_t anchorPos, size_t &start) const;
+
+    void scanScalar(const unsigned char *data, size_t size, size_t from, std::vector<Match> &out) const;
+
+    size_t scanSSE2(const unsigned char *data, size_t size, std::vector<Match> &out) const;
+
+    size_t scanAVX2(const unsigned char *data, size_t size, std::vector<Match> &out) const;
+
+    size_t scanNEON(const unsigned char *data, size_t size, std::vector<Match> &out) const;
+
+public:
+    static bool isSupported(Implementation implementation);
+
+    static Implementation getBestImplementation();
+
+    static const char *getName(Implementation implementation);
+
+    // Same syntax as PatchUtils::patternSearch, hex bytes separated by spaces with ?? as wildcard.
+    // Returns the index of the pattern, throws std::invalid_argument for malformed patterns
+    size_t add(std::string const &pattern);
+
+    size_t size() const { return patterns.size(); }
+
+    // Every match of every pattern, sorted by offset
+    std::vector<Match> scan(const unsigned char *data, size_t size, Implementation implementation = Implementation::AUTO) const;
+
+    // Scans the executable segments of a library loaded by the linker, returns the first match of every pattern or nullptr
+    std::vector<void *> findFirst(void *handle) const;
+};
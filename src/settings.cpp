@@ -23,6 +23,10 @@ std::string Settings::videoMode;
 float Settings::scale;
 std::string Settings::menubarFocusKey;
 bool Settings::fullscreen;
+int Settings::assetCacheSizeMb = 64;
+bool Settings::enableAssetPrefetch = true;
+bool Settings::parallelModLoading = true;
+int Settings::windowPollIntervalMillis = 10;
 
 char GameOptions::leftKey = 'A';
 char GameOptions::downKey = 'S';
@@ -54,6 +58,10 @@ static properties::property<std::string> videoMode(settings, "videoMode", "");
 static properties::property<float> scale(settings, "scale", 1);
 static properties::property<std::string> menubarFocusKey(settings, "menubarFocusKey", "");
 static properties::property<bool> fullscreen(settings, "fullscreen", /* default if not defined*/ false);
+static properties::property<int> assetCacheSizeMb(settings, "assetCacheSizeMb", /* default if not defined*/ 64);
+static properties::property<bool> enableAssetPrefetch(settings, "enableAssetPrefetch", /* default if not defined*/ true);
+static properties::property<bool> parallelModLoading(settings, "parallelModLoading", /* default if not defined*/ true);
+static properties::property<int> windowPollIntervalMillis(settings, "windowPollIntervalMillis", /* default if not defined*/ 10);
 
 std::string Settings::getPath() {
     return PathHelper::getPrimaryDataDirectory() + "mcpelauncher-client-settings.txt";
@@ -86,6 +94,10 @@ void Settings::load() {
     Settings::scale = ::scale.get();
     Settings::menubarFocusKey = ::menubarFocusKey.get();
     Settings::fullscreen = ::fullscreen.get();
+    Settings::assetCacheSizeMb = ::assetCacheSizeMb.get();
+    Settings::enableAssetPrefetch = ::enableAssetPrefetch.get();
+    Settings::parallelModLoading = ::parallelModLoading.get();
+    Settings::windowPollIntervalMillis = ::windowPollIntervalMillis.get();
 }
 
 void Settings::save() {
@@ -111,6 +123,10 @@ void Settings::save() {
     ::menubarFocusKey.set(Settings::menubarFocusKey);
     std::ofstream propertiesFile(getPath());
     ::fullscreen.set(Settings::fullscreen);
+    ::assetCacheSizeMb.set(Settings::assetCacheSizeMb);
+    ::enableAssetPrefetch.set(Settings::enableAssetPrefetch);
+    ::parallelModLoading.set(Settings::parallelModLoading);
+    ::windowPollIntervalMillis.set(Settings::windowPollIntervalMillis);
     if(propertiesFile) {
         settings.save(propertiesFile);
     }
@@ -24,6 +24,13 @@ struct Settings {
 
     static bool fullscreen;
 
+    static int assetCacheSizeMb;
+    static bool enableAssetPrefetch;
+
+    static bool parallelModLoading;
+
+    static int windowPollIntervalMillis;
+
     static std::string getPath();
     static void load();
     static void save();
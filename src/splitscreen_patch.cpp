@@ -3,6 +3,7 @@
 #include <mcpelauncher/patch_utils.h>
 #include <log.h>
 #include "splitscreen_patch.h"
+#include "symbol_index.h"
 
 void (*SplitscreenPatch::glScissor)(int x, int y, unsigned int w, unsigned int h);
 
@@ -11,7 +12,7 @@ void SplitscreenPatch::setScissorRect(void*, int x, int y, unsigned int w, unsig
 }
 
 void SplitscreenPatch::install(void* handle) {
-    void* ptr = linker::dlsym(handle, "_ZN3mce13RenderContext26setViewportWithFullScissorERKNS_12ViewportInfoE");
+    void* ptr = SymbolIndex::resolve(handle, "_ZN3mce13RenderContext26setViewportWithFullScissorERKNS_12ViewportInfoE");
     void* optr = (void*)((size_t)ptr + (0x85E - 0x740));
     if(ptr == nullptr || *((unsigned char*)optr) != 0xE8) {
         Log::error("SplitscreenPatch", "Not patching splitscreen - incompatible code");
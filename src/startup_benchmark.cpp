@@ -0,0 +1,220 @@
+#include "startup_benchmark.h"
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+#include <log.h>
+
+static const char *TAG = "StartupBenchmark";
+static const char *FD_ENV = "MCPELAUNCHER_BENCHMARK_FD";
+
+std::atomic_bool StartupBenchmark::active;
+int StartupBenchmark::resultFd = -1;
+std::atomic<int64_t> StartupBenchmark::lastAssetOpen;
+int64_t StartupBenchmark::readyFrame = 0;
+bool StartupBenchmark::firstFrameSent = false;
+
+static int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void StartupBenchmark::initChild() {
+    auto fd = getenv(FD_ENV);
+    if(fd == nullptr)
+        return;
+    resultFd = atoi(fd);
+    // Neither the variable nor the pipe should reach processes started by the game
+    unsetenv(FD_ENV);
+    fcntl(resultFd, F_SETFD, FD_CLOEXEC);
+    lastAssetOpen = nowNanos();
+    active = true;
+}
+
+void StartupBenchmark::report(const char *event, int64_t agoNanos) {
+    char line[64];
+    int len = snprintf(line, sizeof(line), "%s %" PRId64 "\n", event, agoNanos);
+    if(write(resultFd, line, len) != len)
+        Log::warn(TAG, "Failed to report %s to the benchmark: %s", event, strerror(errno));
+}
+
+void StartupBenchmark::onFrame() {
+    auto now = nowNanos();
+    if(!firstFrameSent) {
+        firstFrameSent = true;
+        report("first_frame", 0);
+    }
+    auto lastOpen = lastAssetOpen.load(std::memory_order_relaxed);
+    if(readyFrame < lastOpen)
+        readyFrame = now;
+    if(now - lastOpen >= quietPeriodNanos) {
+        report("assets_settled", now - readyFrame);
+        // The parent only needs the timings, skip tearing down the game
+        _exit(0);
+    }
+}
+
+void StartupBenchmark::onAssetOpened() {
+    lastAssetOpen.store(nowNanos(), std::memory_order_relaxed);
+}
+
+static std::string getExecutablePath(const char *argv0) {
+#if defined(__linux__)
+    char path[4096];
+    auto len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if(len > 0)
+        return std::string(path, len);
+#elif defined(__APPLE__)
+    char path[4096];
+    uint32_t size = sizeof(path);
+    if(_NSGetExecutablePath(path, &size) == 0)
+        return path;
+#endif
+    return argv0;
+}
+
+static double percentile(std::vector<double> sorted, double p) {
+    if(sorted.empty())
+        return 0;
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+int StartupBenchmark::run(int argc, char *argv[], int runs, int timeoutSeconds, std::string const &outputPath) {
+    struct Run {
+        double firstFrameMs = -1;
+        double assetsSettledMs = -1;
+        int status = 0;
+    };
+    static const char *benchmarkArgs[] = {"--benchmark-startup", "-bs", "--benchmark-output", "-bo", "--benchmark-timeout", "-bt"};
+    std::vector<std::string> args = {getExecutablePath(argv[0])};
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool skip = false;
+        for(auto name : benchmarkArgs) {
+            if(arg == name) {
+                i++;
+                skip = true;
+            } else if(arg.rfind(std::string(name) + "=", 0) == 0) {
+                skip = true;
+            }
+        }
+        if(!skip)
+            args.push_back(std::move(arg));
+    }
+    std::vector<char *> childArgv;
+    for(auto &&arg : args)
+        childArgv.push_back((char *)arg.c_str());
+    childArgv.push_back(nullptr);
+
+    std::vector<Run> results;
+    for(int i = 0; i < runs; i++) {
+        int fds[2];
+        if(pipe(fds) != 0) {
+            Log::error(TAG, "pipe failed: %s", strerror(errno));
+            return 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto elapsedMs = [&]() { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+        pid_t pid = fork();
+        if(pid == 0) {
+            close(fds[0]);
+            setenv(FD_ENV, std::to_string(fds[1]).c_str(), 1);
+            // Mesa throttles to the (virtual) display otherwise, which hides differences smaller than a frame
+            setenv("vblank_mode", "0", 0);
+            execv(childArgv[0], childArgv.data());
+            _exit(127);
+        }
+        close(fds[1]);
+        if(pid < 0) {
+            close(fds[0]);
+            Log::error(TAG, "fork failed: %s", strerror(errno));
+            return 1;
+        }
+
+        Run run;
+        std::string buffer;
+        bool timedOut = false;
+        while(run.assetsSettledMs < 0) {
+            int remainingMs = (int)std::max(timeoutSeconds * 1000.0 - elapsedMs(), 0.0);
+            pollfd pfd = {fds[0], POLLIN, 0};
+            if(poll(&pfd, 1, remainingMs) <= 0) {
+                timedOut = true;
+                break;
+            }
+            char chunk[256];
+            auto len = read(fds[0], chunk, sizeof(chunk));
+            if(len <= 0)
+                break;
+            buffer.append(chunk, len);
+            for(size_t nl; (nl = buffer.find('\n')) != std::string::npos; buffer.erase(0, nl + 1)) {
+                char event[32];
+                long long agoNanos;
+                if(sscanf(buffer.c_str(), "%31s %lld", event, &agoNanos) != 2)
+                    continue;
+                double ms = elapsedMs() - agoNanos / 1e6;
+                if(!strcmp(event, "first_frame"))
+                    run.firstFrameMs = ms;
+                else if(!strcmp(event, "assets_settled"))
+                    run.assetsSettledMs = ms;
+            }
+        }
+        close(fds[0]);
+        if(timedOut) {
+            Log::error(TAG, "Run %d timed out after %d s", i + 1, timeoutSeconds);
+            kill(pid, SIGKILL);
+        }
+        waitpid(pid, &run.status, 0);
+        if(run.assetsSettledMs >= 0)
+            Log::info(TAG, "Run %d/%d: first frame after %.1f ms, assets settled after %.1f ms", i + 1, runs, run.firstFrameMs, run.assetsSettledMs);
+        else
+            Log::error(TAG, "Run %d/%d failed, exit status %d", i + 1, runs, run.status);
+        results.push_back(run);
+    }
+
+    std::vector<double> firstFrame, assetsSettled;
+    for(auto &&r : results) {
+        if(r.assetsSettledMs >= 0) {
+            firstFrame.push_back(r.firstFrameMs);
+            assetsSettled.push_back(r.assetsSettledMs);
+        }
+    }
+    size_t failed = results.size() - assetsSettled.size();
+    auto summarize = [&](const char *name, std::vector<double> const &values) {
+        Log::info(TAG, "%-16s min %10.1f ms  median %10.1f ms  p95 %10.1f ms", name, percentile(values, 0), percentile(values, 0.5), percentile(values, 0.95));
+    };
+    summarize("first frame", firstFrame);
+    summarize("assets settled", assetsSettled);
+    if(failed)
+        Log::error(TAG, "%zu of %d runs failed", failed, runs);
+
+    if(!outputPath.empty()) {
+        FILE *json = fopen(outputPath.c_str(), "w");
+        if(!json) {
+            Log::error(TAG, "Failed to write %s: %s", outputPath.c_str(), strerror(errno));
+            return 1;
+        }
+        fprintf(json, "{\n  \"runs\": [");
+        for(size_t i = 0; i < results.size(); i++) {
+            fprintf(json, "%s\n    {\"first_frame_ms\": %.2f, \"assets_settled_ms\": %.2f, \"ok\": %s}", i ? "," : "", results[i].firstFrameMs, results[i].assetsSettledMs, results[i].assetsSettledMs >= 0 ? "true" : "false");
+        }
+        fprintf(json, "\n  ],\n  \"failed_runs\": %zu", failed);
+        for(auto metric : {std::make_pair("first_frame_ms", &firstFrame), std::make_pair("assets_settled_ms", &assetsSettled)}) {
+            fprintf(json, ",\n  \"%s\": {\"min\": %.2f, \"median\": %.2f, \"p95\": %.2f}", metric.first, percentile(*metric.second, 0), percentile(*metric.second, 0.5), percentile(*metric.second, 0.95));
+        }
+        fprintf(json, "\n}\n");
+        fclose(json);
+    }
+    return failed ? 1 : 0;
+}
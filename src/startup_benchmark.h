@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// --benchmark-startup: starts the launcher several times in child processes and measures the time until the first eglSwapBuffers
+// and until the assets settled. The game has no signal for the main menu, so the first frame after which no asset was opened
+// for quietPeriodNanos stands in for it, a startup which keeps streaming assets runs into the timeout
+class StartupBenchmark {
+private:
+    static std::atomic_bool active;
+    static int resultFd;
+    static std::atomic<int64_t> lastAssetOpen;
+    static int64_t readyFrame;
+    static bool firstFrameSent;
+
+    static void report(const char *event, int64_t agoNanos);
+
+public:
+    // Each child exits once no asset was opened for this long, the assets settled at the first frame after the last open
+    static constexpr int64_t quietPeriodNanos = 3000000000LL;
+
+    // Spawns runs children with the same arguments except the benchmark ones, returns the exit code for main
+    static int run(int argc, char *argv[], int runs, int timeoutSeconds, std::string const &outputPath);
+
+    // Called at the start of main, turns this process into a benchmark child if the parent asked for it
+    static void initChild();
+
+    static bool isActive() {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    // eglSwapBuffers
+    static void onFrame();
+
+    // AAssetManager_open
+    static void onAssetOpened();
+};
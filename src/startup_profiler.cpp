@@ -0,0 +1,122 @@
+#include "startup_profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <unistd.h>
+#include <log.h>
+
+std::atomic_bool StartupProfiler::enabled;
+std::string StartupProfiler::tracePath;
+std::chrono::steady_clock::time_point StartupProfiler::origin;
+std::mutex StartupProfiler::mutex;
+std::vector<StartupProfiler::Event> StartupProfiler::events;
+std::vector<std::pair<int, std::string>> StartupProfiler::threadNames;
+
+static thread_local int scopeDepth = 0;
+
+int StartupProfiler::getThreadId() {
+    static std::atomic_int nextId;
+    static thread_local int id = ++nextId;
+    return id;
+}
+
+int64_t StartupProfiler::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+StartupProfiler::Scope::Scope(const char *name) : name(name), active(isEnabled()) {
+    if(active) {
+        start = now();
+        scopeDepth++;
+    }
+}
+
+void StartupProfiler::Scope::end() {
+    if(!active)
+        return;
+    active = false;
+    scopeDepth--;
+    if(!isEnabled())
+        return;
+    int64_t duration = now() - start;
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back({name, getThreadId(), scopeDepth, start, duration});
+}
+
+void StartupProfiler::enable(std::string tracePath) {
+    StartupProfiler::tracePath = std::move(tracePath);
+    origin = std::chrono::steady_clock::now();
+    enabled = true;
+    setThreadName("main");
+}
+
+void StartupProfiler::setThreadName(const char *name) {
+    if(!isEnabled())
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    threadNames.emplace_back(getThreadId(), name);
+}
+
+void StartupProfiler::onFirstFrame() {
+    bool expected = true;
+    if(!enabled.compare_exchange_strong(expected, false))
+        return;
+    int64_t firstFrame = now();
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back({"first eglSwapBuffers", getThreadId(), -1, firstFrame, 0});
+    writeTrace();
+
+    // Top level phases of every thread, in the order they started
+    std::vector<Event const *> phases;
+    for(auto &&event : events) {
+        if(event.depth == 0)
+            phases.push_back(&event);
+    }
+    std::sort(phases.begin(), phases.end(), [](Event const *a, Event const *b) { return a->startUs < b->startUs; });
+    std::stringstream summary;
+    summary << "first frame after " << firstFrame / 1000 << " ms";
+    for(auto &&phase : phases)
+        summary << ", " << phase->name << " " << phase->durationUs / 1000 << " ms";
+    Log::info("StartupProfiler", "%s", summary.str().c_str());
+}
+
+// Task names include the file names of mods, which may contain anything
+static std::string escapeJson(std::string const &str) {
+    std::string ret;
+    for(unsigned char c : str) {
+        if(c == '"' || c == '\\') {
+            ret += '\\';
+            ret += (char)c;
+        } else if(c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            ret += buf;
+        } else {
+            ret += (char)c;
+        }
+    }
+    return ret;
+}
+
+void StartupProfiler::writeTrace() {
+    FILE *f = fopen(tracePath.c_str(), "w");
+    if(!f) {
+        Log::error("StartupProfiler", "Failed to write %s", tracePath.c_str());
+        return;
+    }
+    int pid = (int)getpid();
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(f, "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": 0, \"args\": {\"name\": \"mcpelauncher-client\"}}", pid);
+    for(auto &&thread : threadNames)
+        fprintf(f, ",\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", pid, thread.first, escapeJson(thread.second).c_str());
+    for(auto &&event : events) {
+        auto name = escapeJson(event.name);
+        if(event.depth >= 0)
+            fprintf(f, ",\n  {\"name\": \"%s\", \"ph\": \"X\", \"ts\": %lld, \"dur\": %lld, \"pid\": %d, \"tid\": %d}", name.c_str(), (long long)event.startUs, (long long)event.durationUs, pid, event.tid);
+        else
+            fprintf(f, ",\n  {\"name\": \"%s\", \"ph\": \"i\", \"s\": \"g\", \"ts\": %lld, \"pid\": %d, \"tid\": %d}", name.c_str(), (long long)event.startUs, pid, event.tid);
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    Log::info("StartupProfiler", "Wrote startup trace to %s", tracePath.c_str());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline of the startup phases up to the first eglSwapBuffers, written as a chrome trace (chrome://tracing, ui.perfetto.dev)
+class StartupProfiler {
+private:
+    struct Event {
+        std::string name;
+        int tid;
+        int depth; // -1 for instant events
+        int64_t startUs;
+        int64_t durationUs;
+    };
+
+    static std::atomic_bool enabled;
+    static std::string tracePath;
+    static std::chrono::steady_clock::time_point origin;
+    static std::mutex mutex;
+    static std::vector<Event> events;
+    static std::vector<std::pair<int, std::string>> threadNames;
+
+    static int getThreadId();
+
+    static int64_t now();
+
+    static void writeTrace();
+
+public:
+    // Times the enclosing block, or until end() is called
+    class Scope {
+    private:
+        const char *name;
+        int64_t start = 0;
+        bool active;
+
+    public:
+        explicit Scope(const char *name);
+
+        Scope(Scope const &) = delete;
+        Scope &operator=(Scope const &) = delete;
+
+        ~Scope() {
+            end();
+        }
+
+        void end();
+    };
+
+    static void enable(std::string tracePath);
+
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    static void setThreadName(const char *name);
+
+    // Ends profiling and writes the trace, only the first call has an effect
+    static void onFirstFrame();
+};
@@ -0,0 +1,98 @@
+#include "startup_task_graph.h"
+#include "startup_profiler.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <log.h>
+
+unsigned StartupTaskGraph::getDefaultWorkerCount() {
+    // Most steps are serialized by the linker anyway, more threads don't help
+    return std::min(std::max(std::thread::hardware_concurrency(), 2u) - 1, 3u);
+}
+
+StartupTaskGraph::TaskId StartupTaskGraph::add(const char *name, std::vector<TaskId> const &dependencies, std::function<void()> fn, bool mainThread) {
+    TaskId id = tasks.size();
+    for(auto dependency : dependencies) {
+        if(dependency >= id)
+            throw std::invalid_argument("Dependencies have to be added before the task");
+        tasks[dependency].dependents.push_back(id);
+    }
+    tasks.push_back({name, std::move(fn), {}, dependencies.size(), mainThread, false});
+    return id;
+}
+
+void StartupTaskGraph::skip(TaskId id) {
+    auto &task = tasks[id];
+    if(task.skipped)
+        return;
+    Log::warn("StartupTaskGraph", "Skipping %s", task.name);
+    task.skipped = true;
+    remaining--;
+    for(auto dependent : task.dependents)
+        skip(dependent);
+}
+
+void StartupTaskGraph::runTasks(bool mainThread) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        std::deque<TaskId>::iterator it;
+        cv.wait(lock, [&]() {
+            if(remaining == 0)
+                return true;
+            it = std::find_if(ready.begin(), ready.end(), [&](TaskId id) { return mainThread || !tasks[id].mainThread; });
+            return it != ready.end();
+        });
+        if(remaining == 0)
+            return;
+        TaskId id = *it;
+        ready.erase(it);
+        auto &task = tasks[id];
+        lock.unlock();
+
+        std::exception_ptr taskError;
+        try {
+            StartupProfiler::Scope scope(task.name);
+            task.fn();
+        } catch(...) {
+            taskError = std::current_exception();
+        }
+
+        lock.lock();
+        remaining--;
+        if(taskError) {
+            if(!error)
+                error = taskError;
+            for(auto dependent : task.dependents)
+                skip(dependent);
+        } else {
+            for(auto dependent : task.dependents) {
+                if(--tasks[dependent].pendingDependencies == 0 && !tasks[dependent].skipped)
+                    ready.push_back(dependent);
+            }
+        }
+        cv.notify_all();
+    }
+}
+
+void StartupTaskGraph::run(unsigned workers) {
+    remaining = tasks.size();
+    for(TaskId id = 0; id < tasks.size(); id++) {
+        if(tasks[id].pendingDependencies == 0)
+            ready.push_back(id);
+    }
+    std::vector<std::thread> threads;
+    for(unsigned i = 0; i < workers; i++) {
+        threads.emplace_back([this]() {
+            StartupProfiler::setThreadName("startup worker");
+            runTasks(false);
+        });
+    }
+    runTasks(true);
+    for(auto &&thread : threads)
+        thread.join();
+    tasks.clear();
+    ready.clear();
+    if(error)
+        std::rethrow_exception(std::exchange(error, nullptr));
+}
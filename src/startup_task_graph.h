@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Runs the independent steps of the startup concurrently, each task starts once all of its dependencies finished
+class StartupTaskGraph {
+public:
+    using TaskId = size_t;
+
+private:
+    struct Task {
+        const char *name;
+        std::function<void()> fn;
+        std::vector<TaskId> dependents;
+        size_t pendingDependencies;
+        bool mainThread;
+        bool skipped;
+    };
+
+    std::vector<Task> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<TaskId> ready;
+    size_t remaining = 0;
+    std::exception_ptr error;
+
+    void skip(TaskId id);
+
+    void runTasks(bool mainThread);
+
+public:
+    static unsigned getDefaultWorkerCount();
+
+    // mainThread tasks only run on the thread calling run(), e.g. to create the window
+    TaskId add(const char *name, std::vector<TaskId> const &dependencies, std::function<void()> fn, bool mainThread = false);
+
+    // Blocks until every task finished, the tasks depending on a failed task are skipped and the first exception is rethrown.
+    // The tasks are removed afterwards, tasks added later start a new graph which can be run again
+    void run(unsigned workers = getDefaultWorkerCount());
+};
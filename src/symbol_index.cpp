@@ -0,0 +1,193 @@
+#include "symbol_index.h"
+#include "loaded_segments.h"
+#include <chrono>
+#include <cstring>
+#include <log.h>
+#include <mcpelauncher/linker.h>
+#include <mcpelauncher/minecraft_utils.h>
+
+#if UINTPTR_MAX > 0xFFFFFFFFu
+struct ElfSym {
+    uint32_t name;
+    unsigned char info;
+    unsigned char other;
+    uint16_t shndx;
+    uint64_t value;
+    uint64_t size;
+};
+#else
+struct ElfSym {
+    uint32_t name;
+    uint32_t value;
+    uint32_t size;
+    unsigned char info;
+    unsigned char other;
+    uint16_t shndx;
+};
+#endif
+
+static constexpr intptr_t DT_HASH_ = 4;
+static constexpr intptr_t DT_STRTAB_ = 5;
+static constexpr intptr_t DT_SYMTAB_ = 6;
+static constexpr intptr_t DT_GNU_HASH_ = 0x6ffffef5;
+static constexpr intptr_t DT_VERSYM_ = 0x6ffffff0;
+static constexpr unsigned STT_TLS_ = 6;
+static constexpr unsigned STT_GNU_IFUNC_ = 10;
+static constexpr unsigned STB_GLOBAL_ = 1;
+static constexpr unsigned STB_WEAK_ = 2;
+static constexpr uint16_t VERSYM_HIDDEN_ = 0x8000;
+static constexpr uint16_t SHN_LORESERVE_ = 0xff00;
+
+void *SymbolIndex::handle;
+uintptr_t SymbolIndex::base;
+const char *SymbolIndex::strtab;
+const void *SymbolIndex::symtab;
+const uint32_t *SymbolIndex::gnuHash;
+const uint32_t *SymbolIndex::sysvHash;
+const uint16_t *SymbolIndex::versym;
+std::atomic<uint64_t> SymbolIndex::lookups;
+std::atomic<uint64_t> SymbolIndex::fallbacks;
+std::atomic<uint64_t> SymbolIndex::nanos;
+
+bool SymbolIndex::build(void *handle) {
+    SymbolIndex::handle = nullptr;
+    base = MinecraftUtils::getLibraryBase(handle);
+    const intptr_t *dynamic = nullptr;
+    for(auto &&segment : getLoadedSegments(handle)) {
+        if(segment.type == LoadedSegment::PT_DYNAMIC_)
+            dynamic = (const intptr_t *)segment.start;
+    }
+    if(!dynamic)
+        return false;
+    strtab = nullptr;
+    symtab = nullptr;
+    gnuHash = sysvHash = nullptr;
+    versym = nullptr;
+    // The linker keeps the dynamic section as in the file, so these are relative to the base (glibc relocates them in place)
+    for(auto d = dynamic; d[0] != 0; d += 2) {
+        auto ptr = (uintptr_t)d[1] >= base ? (uintptr_t)d[1] : base + (uintptr_t)d[1];
+        switch(d[0]) {
+        case DT_STRTAB_:
+            strtab = (const char *)ptr;
+            break;
+        case DT_SYMTAB_:
+            symtab = (const void *)ptr;
+            break;
+        case DT_GNU_HASH_:
+            gnuHash = (const uint32_t *)ptr;
+            break;
+        case DT_HASH_:
+            sysvHash = (const uint32_t *)ptr;
+            break;
+        case DT_VERSYM_:
+            versym = (const uint16_t *)ptr;
+            break;
+        }
+    }
+    if(!strtab || !symtab || (!gnuHash && !sysvHash))
+        return false;
+    SymbolIndex::handle = handle;
+    return true;
+}
+
+bool SymbolIndex::isExported(uint32_t index) {
+    auto &sym = ((const ElfSym *)symtab)[index];
+    unsigned bind = sym.info >> 4;
+    unsigned type = sym.info & 0xF;
+    // Absolute symbols like the version names aren't addresses in the library, the linker calls the resolver of an ifunc
+    if(sym.shndx == 0 || sym.shndx >= SHN_LORESERVE_ || sym.value == 0 || (bind != STB_GLOBAL_ && bind != STB_WEAK_) || type == STT_TLS_ || type == STT_GNU_IFUNC_)
+        return false;
+    return !versym || !(versym[index] & VERSYM_HIDDEN_);
+}
+
+void *SymbolIndex::lookupGnu(const char *name) {
+    uint32_t hash = 5381;
+    for(auto c = (const unsigned char *)name; *c; c++)
+        hash = hash * 33 + *c;
+    uint32_t nbuckets = gnuHash[0], symoffset = gnuHash[1], bloomSize = gnuHash[2], bloomShift = gnuHash[3];
+    auto bloom = (const uintptr_t *)(gnuHash + 4);
+    auto buckets = (const uint32_t *)(bloom + bloomSize);
+    auto chain = buckets + nbuckets;
+    constexpr uint32_t bits = sizeof(uintptr_t) * 8;
+    uintptr_t word = bloom[(hash / bits) % bloomSize];
+    uintptr_t mask = ((uintptr_t)1 << (hash % bits)) | ((uintptr_t)1 << ((hash >> bloomShift) % bits));
+    if((word & mask) != mask)
+        return nullptr;
+    uint32_t index = buckets[hash % nbuckets];
+    if(index < symoffset)
+        return nullptr;
+    auto syms = (const ElfSym *)symtab;
+    while(true) {
+        uint32_t chainHash = chain[index - symoffset];
+        auto &sym = syms[index];
+        if((hash | 1) == (chainHash | 1) && strcmp(name, strtab + sym.name) == 0 && isExported(index))
+            return (void *)(base + sym.value);
+        if(chainHash & 1)
+            return nullptr;
+        index++;
+    }
+}
+
+void *SymbolIndex::lookupSysv(const char *name) {
+    uint32_t hash = 0;
+    for(auto c = (const unsigned char *)name; *c; c++) {
+        hash = (hash << 4) + *c;
+        uint32_t g = hash & 0xf0000000;
+        hash ^= g >> 24;
+        hash &= ~g;
+    }
+    uint32_t nbuckets = sysvHash[0];
+    auto buckets = sysvHash + 2;
+    auto chain = buckets + nbuckets;
+    auto syms = (const ElfSym *)symtab;
+    for(uint32_t index = buckets[hash % nbuckets]; index != 0; index = chain[index]) {
+        auto &sym = syms[index];
+        if(strcmp(name, strtab + sym.name) == 0 && isExported(index))
+            return (void *)(base + sym.value);
+    }
+    return nullptr;
+}
+
+void *SymbolIndex::lookup(void *handle, const char *name) {
+    void *ret = nullptr;
+    if(handle == SymbolIndex::handle && handle)
+        ret = gnuHash ? lookupGnu(name) : lookupSysv(name);
+#ifndef NDEBUG
+    if(ret) {
+        // Debug builds check every indexed symbol against the linker, which stays authoritative
+        void *linkerRet = linker::dlsym(handle, name);
+        if(linkerRet != ret) {
+            Log::warn("SymbolIndex", "%s resolved to %p, but linker::dlsym returned %p", name, ret, linkerRet);
+            ret = linkerRet;
+        }
+    }
+#endif
+    if(!ret) {
+        // Not exported by the library itself, the linker also searches its dependencies
+        fallbacks.fetch_add(1, std::memory_order_relaxed);
+        ret = linker::dlsym(handle, name);
+    }
+    return ret;
+}
+
+void *SymbolIndex::resolve(void *handle, const char *name) {
+    auto start = std::chrono::steady_clock::now();
+    auto ret = lookup(handle, name);
+    lookups.fetch_add(1, std::memory_order_relaxed);
+    nanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+    return ret;
+}
+
+void SymbolIndex::resolveAll(void *handle, std::vector<std::string> const &names, std::vector<void *> &symbols) {
+    auto start = std::chrono::steady_clock::now();
+    symbols.resize(names.size());
+    for(size_t i = 0; i < names.size(); i++)
+        symbols[i] = lookup(handle, names[i].c_str());
+    lookups.fetch_add(names.size(), std::memory_order_relaxed);
+    nanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+}
+
+void SymbolIndex::logStats() {
+    Log::info("SymbolIndex", "Resolved %llu symbols in %.3f ms, %llu through linker::dlsym (%s)", (unsigned long long)lookups.load(), nanos.load() / 1e6, (unsigned long long)fallbacks.load(),
+              handle ? (gnuHash ? "gnu hash" : "sysv hash") : "no index");
+}
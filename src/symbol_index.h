@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Looks up symbols of the game library directly in its GNU (or SysV) hash table, without the linker lock
+// and dependency walk of linker::dlsym. Only symbols linker::dlsym would return from the library itself are answered
+// (defined, global or weak, no TLS, no hidden version), everything else falls back to linker::dlsym.
+class SymbolIndex {
+private:
+    static void *handle;
+    static uintptr_t base;
+    static const char *strtab;
+    static const void *symtab;
+    static const uint32_t *gnuHash;
+    static const uint32_t *sysvHash;
+    static const uint16_t *versym;
+
+    static std::atomic<uint64_t> lookups;
+    static std::atomic<uint64_t> fallbacks;
+    static std::atomic<uint64_t> nanos;
+
+    static bool isExported(uint32_t index);
+
+    static void *lookupGnu(const char *name);
+
+    static void *lookupSysv(const char *name);
+
+    static void *lookup(void *handle, const char *name);
+
+public:
+    // Reads the dynamic section of a library loaded by the linker, returns false if it has no usable hash table
+    static bool build(void *handle);
+
+    static void *resolve(void *handle, const char *name);
+
+    static void resolveAll(void *handle, std::vector<std::string> const &names, std::vector<void *> &symbols);
+
+    // Logs how many symbols were resolved and how long it took in total
+    static void logStats();
+};
@@ -5,6 +5,7 @@
 #include <game_window_manager.h>
 #include <log.h>
 #include <mcpelauncher/path_helper.h>
+#include <algorithm>
 #include <cstdlib>
 #include <string>
 #include "settings.h"
@@ -265,7 +266,9 @@ void WindowCallbacks::onTouchStart(int id, double x, double y) {
             }
         }
 #endif
-        inputQueue.addEvent(FakeMotionEvent(AINPUT_SOURCE_TOUCHSCREEN, AMOTION_EVENT_ACTION_DOWN, id, x, y - Settings::menubarsize));
+        FakeMotionEvent event;
+        if(touchPointers.down(id, (float)x, (float)(y - Settings::menubarsize), event))
+            inputQueue.addEvent(event);
     }
 }
 void WindowCallbacks::onTouchUpdate(int id, double x, double y) {
@@ -278,11 +281,15 @@ void WindowCallbacks::onTouchUpdate(int id, double x, double y) {
             return;
         }
 #endif
-        inputQueue.addEvent(FakeMotionEvent(AINPUT_SOURCE_TOUCHSCREEN, AMOTION_EVENT_ACTION_MOVE, id, x, y - Settings::menubarsize));
+        FakeMotionEvent event;
+        if(touchPointers.move(id, (float)x, (float)(y - Settings::menubarsize), event))
+            inputQueue.addEvent(event);
     }
 }
 void WindowCallbacks::onTouchEnd(int id, double x, double y) {
-    if(hasInputMode(InputMode::Touch)) {
+    bool isDown = touchPointers.contains(id);
+    // Pointers which went down always go up, even if the input mode changed in between
+    if(isDown || hasInputMode(InputMode::Touch)) {
 #ifdef USE_IMGUI
         if(ImGui::GetCurrentContext() && imGuiTouchId == id) {
             imGuiTouchId = -1;
@@ -290,10 +297,14 @@ void WindowCallbacks::onTouchEnd(int id, double x, double y) {
             io.AddMouseSourceEvent(ImGuiMouseSource_Mouse);
             io.AddMousePosEvent(x, y);
             io.AddMouseButtonEvent(ImGuiMouseButton_Left, false);
-            return;
+            // The game got the down if imgui didn't capture it
+            if(!isDown)
+                return;
         }
 #endif
-        inputQueue.addEvent(FakeMotionEvent(AINPUT_SOURCE_TOUCHSCREEN, AMOTION_EVENT_ACTION_UP, id, x, y - Settings::menubarsize));
+        FakeMotionEvent event;
+        if(touchPointers.up(id, (float)x, (float)(y - Settings::menubarsize), event))
+            inputQueue.addEvent(event);
     }
 }
 static bool deadKey(KeyCode key) {
@@ -616,44 +627,22 @@ void WindowCallbacks::onGamepadState(int gamepad, bool connected) {
     }
 }
 
-void WindowCallbacks::queueGamepadAxisInputIfNeeded(int gamepad) {
-    if(!needsQueueGamepadInput)
+void WindowCallbacks::queueGamepadAxisInput(int gamepad) {
+    auto gpi = gamepads.find(gamepad);
+    if(gpi == gamepads.end())
         return;
-    inputQueue.addEvent(FakeMotionEvent(AINPUT_SOURCE_GAMEPAD, gamepad, AMOTION_EVENT_ACTION_MOVE, 0, 0.f, 0.f,
-                                        [this, gamepad](int axis) {
-                                            auto gpi = gamepads.find(gamepad);
-                                            if(gpi == gamepads.end())
-                                                return 0.f;
-                                            auto& gp = gpi->second;
-                                            if(axis == AMOTION_EVENT_AXIS_X)
-                                                return gp.axis[(int)GamepadAxisId::LEFT_X];
-                                            if(axis == AMOTION_EVENT_AXIS_Y)
-                                                return gp.axis[(int)GamepadAxisId::LEFT_Y];
-                                            if(axis == AMOTION_EVENT_AXIS_RX)
-                                                return gp.axis[(int)GamepadAxisId::RIGHT_X];
-                                            if(axis == AMOTION_EVENT_AXIS_RY)
-                                                return gp.axis[(int)GamepadAxisId::RIGHT_Y];
-                                            if(axis == AMOTION_EVENT_AXIS_BRAKE)
-                                                return gp.axis[(int)GamepadAxisId::LEFT_TRIGGER];
-                                            if(axis == AMOTION_EVENT_AXIS_GAS)
-                                                return gp.axis[(int)GamepadAxisId::RIGHT_TRIGGER];
-                                            if(axis == AMOTION_EVENT_AXIS_HAT_X) {
-                                                if(gp.button[(int)GamepadButtonId::DPAD_LEFT])
-                                                    return -1.f;
-                                                if(gp.button[(int)GamepadButtonId::DPAD_RIGHT])
-                                                    return 1.f;
-                                                return 0.f;
-                                            }
-                                            if(axis == AMOTION_EVENT_AXIS_HAT_Y) {
-                                                if(gp.button[(int)GamepadButtonId::DPAD_UP])
-                                                    return -1.f;
-                                                if(gp.button[(int)GamepadButtonId::DPAD_DOWN])
-                                                    return 1.f;
-                                                return 0.f;
-                                            }
-                                            return 0.f;
-                                        }));
-    needsQueueGamepadInput = false;
+    auto& gp = gpi->second;
+    // Merged by the input queue with the other updates of this gamepad until the end of the window event loop iteration
+    FakeMotionEvent event(AINPUT_SOURCE_GAMEPAD, gamepad, AMOTION_EVENT_ACTION_MOVE, 0, 0.f, 0.f);
+    event.axisValues[AMOTION_EVENT_AXIS_X] = gp.axis[(int)GamepadAxisId::LEFT_X];
+    event.axisValues[AMOTION_EVENT_AXIS_Y] = gp.axis[(int)GamepadAxisId::LEFT_Y];
+    event.axisValues[AMOTION_EVENT_AXIS_RX] = gp.axis[(int)GamepadAxisId::RIGHT_X];
+    event.axisValues[AMOTION_EVENT_AXIS_RY] = gp.axis[(int)GamepadAxisId::RIGHT_Y];
+    event.axisValues[AMOTION_EVENT_AXIS_BRAKE] = gp.axis[(int)GamepadAxisId::LEFT_TRIGGER];
+    event.axisValues[AMOTION_EVENT_AXIS_GAS] = gp.axis[(int)GamepadAxisId::RIGHT_TRIGGER];
+    event.axisValues[AMOTION_EVENT_AXIS_HAT_X] = gp.button[(int)GamepadButtonId::DPAD_LEFT] ? -1.f : gp.button[(int)GamepadButtonId::DPAD_RIGHT] ? 1.f : 0.f;
+    event.axisValues[AMOTION_EVENT_AXIS_HAT_Y] = gp.button[(int)GamepadButtonId::DPAD_UP] ? -1.f : gp.button[(int)GamepadButtonId::DPAD_DOWN] ? 1.f : 0.f;
+    inputQueue.addEvent(event);
 }
 
 void WindowCallbacks::onGamepadButton(int gamepad, GamepadButtonId btn, bool pressed) {
@@ -669,7 +658,7 @@ void WindowCallbacks::onGamepadButton(int gamepad, GamepadButtonId btn, bool pre
         gp.button[(int)btn] = pressed;
 
         if(btn == GamepadButtonId::DPAD_UP || btn == GamepadButtonId::DPAD_DOWN || btn == GamepadButtonId::DPAD_LEFT || btn == GamepadButtonId::DPAD_RIGHT) {
-            queueGamepadAxisInputIfNeeded(gamepad);
+            queueGamepadAxisInput(gamepad);
             return;
         }
 
@@ -689,7 +678,7 @@ void WindowCallbacks::onGamepadAxis(int gamepad, GamepadAxisId ax, float value)
         if((int)ax < 0 || (int)ax >= 6)
             throw std::runtime_error("bad axis id");
         gp.axis[(int)ax] = value;
-        queueGamepadAxisInputIfNeeded(gamepad);
+        queueGamepadAxisInput(gamepad);
     }
 }
 
@@ -55,7 +55,6 @@ private:
     int32_t metaState = 0;
     bool useDirectMouseInput, useDirectKeyboardInput;
     bool modCTRL = false;
-    bool needsQueueGamepadInput = true;
     bool sendEvents = false;
     bool cursorLocked = false;
     bool imguiTextInput = false;
@@ -67,6 +66,7 @@ private:
         Unknown,
     };
     int imGuiTouchId = -1;
+    FakeTouchPointers touchPointers;
     bool useRawInput = false;
     InputMode inputMode = InputMode::Unknown;
     InputMode forcedMode = InputMode::Unknown;
@@ -74,7 +74,7 @@ private:
     std::chrono::high_resolution_clock::time_point lastUpdated;
     bool hasInputMode(InputMode want = InputMode::Unknown, bool changeMode = true);
 
-    void queueGamepadAxisInputIfNeeded(int gamepad);
+    void queueGamepadAxisInput(int gamepad);
 
 public:
     WindowCallbacks(GameWindow &window, JniSupport &jniSupport, FakeInputQueue &inputQueue);
@@ -85,8 +85,6 @@ public:
 
     void startSendEvents();
 
-    void markRequeueGamepadInput() { needsQueueGamepadInput = true; }
-
     void onWindowSizeCallback(int w, int h);
 
     void setCursorLocked(bool locked);
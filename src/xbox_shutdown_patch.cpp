@@ -4,6 +4,7 @@
 #include <mcpelauncher/patch_utils.h>
 #include <cstring>
 #include <log.h>
+#include "symbol_index.h"
 #include <mcpelauncher/minecraft_version.h>
 
 std::condition_variable XboxShutdownPatch::cv;
@@ -20,7 +21,7 @@ void XboxShutdownPatch::sleepHook(unsigned int ms) {
 }
 
 void XboxShutdownPatch::install(void* handle) {
-    void* ptr = linker::dlsym(handle, "_ZN4xbox8services5utils5sleepEj");
+    void* ptr = SymbolIndex::resolve(handle, "_ZN4xbox8services5utils5sleepEj");
     if(ptr == nullptr) {
         Log::warn("XboxShutdownPatch", "sleep() symbol not found");
         return;
@@ -0,0 +1,165 @@
+#include "zip_asset_archive.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <log.h>
+
+static constexpr uint32_t EOCD_SIGNATURE = 0x06054b50;
+static constexpr uint32_t ZIP64_EOCD_LOCATOR_SIGNATURE = 0x07064b50;
+static constexpr uint32_t ZIP64_EOCD_SIGNATURE = 0x06064b50;
+static constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+static constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static constexpr size_t EOCD_SIZE = 22;
+static constexpr size_t CENTRAL_HEADER_SIZE = 46;
+static constexpr size_t LOCAL_HEADER_SIZE = 30;
+
+static uint16_t read16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read64(const unsigned char *p) {
+    return (uint64_t)read32(p) | ((uint64_t)read32(p + 4) << 32);
+}
+
+ZipAssetArchive::ZipAssetArchive(std::string path) : path(std::move(path)) {
+    int fd = open(this->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        throw std::runtime_error("Failed to open " + this->path + ": " + strerror(errno));
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size < EOCD_SIZE) {
+        close(fd);
+        throw std::runtime_error(this->path + " is not a zip file");
+    }
+    void *m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(m == MAP_FAILED)
+        throw std::runtime_error("Failed to map " + this->path + ": " + strerror(errno));
+    mapping = (const unsigned char *)m;
+    mappingSize = (size_t)st.st_size;
+
+    try {
+        // An apk keeps the game assets below assets/, a plain archive is the assets root itself
+        auto ext = this->path.size() >= 4 ? this->path.substr(this->path.size() - 4) : std::string();
+        readCentralDirectory(ext == ".apk" ? "assets/" : "");
+    } catch(...) {
+        munmap((void *)mapping, mappingSize);
+        throw;
+    }
+}
+
+ZipAssetArchive::~ZipAssetArchive() {
+    munmap((void *)mapping, mappingSize);
+}
+
+void ZipAssetArchive::readCentralDirectory(std::string const &prefix) {
+    // The end of central directory record is followed by a comment of at most 64KiB
+    const unsigned char *eocd = nullptr;
+    size_t searchEnd = mappingSize > EOCD_SIZE + 0xFFFF ? mappingSize - EOCD_SIZE - 0xFFFF : 0;
+    for(size_t i = mappingSize - EOCD_SIZE + 1; i-- > searchEnd;) {
+        if(read32(mapping + i) == EOCD_SIGNATURE) {
+            eocd = mapping + i;
+            break;
+        }
+    }
+    if(!eocd)
+        throw std::runtime_error(path + ": end of central directory not found");
+
+    uint64_t count = read16(eocd + 10);
+    uint64_t cdSize = read32(eocd + 12);
+    uint64_t cdOffset = read32(eocd + 16);
+    if((size_t)(eocd - mapping) >= 20 && read32(eocd - 20) == ZIP64_EOCD_LOCATOR_SIGNATURE) {
+        uint64_t zip64Offset = read64(eocd - 20 + 8);
+        if(zip64Offset + 56 > mappingSize || read32(mapping + zip64Offset) != ZIP64_EOCD_SIGNATURE)
+            throw std::runtime_error(path + ": invalid zip64 end of central directory");
+        count = read64(mapping + zip64Offset + 32);
+        cdSize = read64(mapping + zip64Offset + 40);
+        cdOffset = read64(mapping + zip64Offset + 48);
+    }
+    if(cdOffset > mappingSize || cdSize > mappingSize - cdOffset)
+        throw std::runtime_error(path + ": central directory out of bounds");
+
+    entries.reserve(count);
+    const unsigned char *p = mapping + cdOffset;
+    const unsigned char *end = p + cdSize;
+    for(uint64_t i = 0; i < count; i++) {
+        if(p + CENTRAL_HEADER_SIZE > end || read32(p) != CENTRAL_HEADER_SIGNATURE)
+            throw std::runtime_error(path + ": corrupt central directory");
+        uint16_t flags = read16(p + 8);
+        uint16_t method = read16(p + 10);
+        uint64_t compressedSize = read32(p + 20);
+        uint64_t uncompressedSize = read32(p + 24);
+        uint16_t nameLength = read16(p + 28);
+        uint16_t extraLength = read16(p + 30);
+        uint16_t commentLength = read16(p + 32);
+        uint64_t localHeaderOffset = read32(p + 42);
+        const unsigned char *name = p + CENTRAL_HEADER_SIZE;
+        const unsigned char *extra = name + nameLength;
+        const unsigned char *next = extra + extraLength + commentLength;
+        if(next > end)
+            throw std::runtime_error(path + ": corrupt central directory");
+
+        // Sizes which don't fit into 32 bit are stored in the zip64 extra field, in this order
+        for(const unsigned char *e = extra; e + 4 <= extra + extraLength;) {
+            uint16_t id = read16(e), size = read16(e + 2);
+            const unsigned char *v = e + 4, *vend = v + size;
+            if(vend > extra + extraLength)
+                break;
+            if(id == 0x0001) {
+                if(uncompressedSize == 0xFFFFFFFF && v + 8 <= vend) {
+                    uncompressedSize = read64(v);
+                    v += 8;
+                }
+                if(compressedSize == 0xFFFFFFFF && v + 8 <= vend) {
+                    compressedSize = read64(v);
+                    v += 8;
+                }
+                if(localHeaderOffset == 0xFFFFFFFF && v + 8 <= vend)
+                    localHeaderOffset = read64(v);
+                break;
+            }
+            e = vend;
+        }
+        p = next;
+
+        if(nameLength <= prefix.size() || memcmp(name, prefix.data(), prefix.size()) != 0)
+            continue;
+        if(name[nameLength - 1] == '/')
+            continue;  // directories are implied by the paths of their files
+        if(flags & 1) {
+            Log::warn("ZipAssetArchive", "Skipping encrypted entry '%.*s'", (int)nameLength, name);
+            continue;
+        }
+        if(method != STORED && method != DEFLATED) {
+            Log::warn("ZipAssetArchive", "Skipping entry '%.*s' with unsupported compression method %i", (int)nameLength, name, (int)method);
+            continue;
+        }
+        // Stored entries are served with their uncompressed size, which is only bounds checked through the compressed size
+        if(method == STORED && compressedSize != uncompressedSize) {
+            Log::warn("ZipAssetArchive", "Skipping stored entry '%.*s' with mismatching sizes", (int)nameLength, name);
+            continue;
+        }
+        if(localHeaderOffset > mappingSize || compressedSize > mappingSize - localHeaderOffset)
+            throw std::runtime_error(path + ": entry data out of bounds");
+        entries.push_back({std::string((const char *)name + prefix.size(), nameLength - prefix.size()), method, compressedSize, uncompressedSize, localHeaderOffset});
+    }
+}
+
+const unsigned char *ZipAssetArchive::getEntryData(Entry const &entry) const {
+    // The local header is only read on open, indexing doesn't need to touch the pages of every entry
+    const unsigned char *local = mapping + entry.localHeaderOffset;
+    if(entry.localHeaderOffset + LOCAL_HEADER_SIZE > mappingSize || read32(local) != LOCAL_HEADER_SIGNATURE)
+        return nullptr;
+    uint64_t dataOffset = entry.localHeaderOffset + LOCAL_HEADER_SIZE + read16(local + 26) + read16(local + 28);
+    if(dataOffset > mappingSize || entry.compressedSize > mappingSize - dataOffset)
+        return nullptr;
+    return mapping + dataOffset;
+}
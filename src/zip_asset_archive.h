@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only view of an apk or zip file, indexed once from its central directory
+class ZipAssetArchive {
+public:
+    enum Method : uint16_t {
+        STORED = 0,
+        DEFLATED = 8,
+    };
+
+    struct Entry {
+        // Relative to the assets root, for an apk the "assets/" prefix is stripped
+        std::string name;
+        uint16_t method;
+        uint64_t compressedSize;
+        uint64_t uncompressedSize;
+        uint64_t localHeaderOffset;
+    };
+
+private:
+    std::string path;
+    const unsigned char *mapping = nullptr;
+    size_t mappingSize = 0;
+    std::vector<Entry> entries;
+
+    void readCentralDirectory(std::string const &prefix);
+
+public:
+    // Throws std::runtime_error if the archive can't be mapped or has no valid central directory
+    explicit ZipAssetArchive(std::string path);
+
+    ZipAssetArchive(ZipAssetArchive const &) = delete;
+    ZipAssetArchive &operator=(ZipAssetArchive const &) = delete;
+
+    ~ZipAssetArchive();
+
+    std::string const &getPath() const { return path; }
+
+    std::vector<Entry> const &getEntries() const { return entries; }
+
+    // Start of the (possibly compressed) entry data inside the mapping, nullptr if the local header is corrupt
+    const unsigned char *getEntryData(Entry const &entry) const;
+};
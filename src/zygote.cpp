@@ -0,0 +1,195 @@
+#include "zygote.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <log.h>
+
+static const char *TAG = "Zygote";
+
+static sockaddr_un getAddress(std::string const &socketPath) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("Socket path too long: " + socketPath);
+    memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    return addr;
+}
+
+static bool readLine(int fd, std::string &line) {
+    line.clear();
+    char c;
+    while(line.size() < 4096) {
+        auto r = read(fd, &c, 1);
+        if(r < 0 && errno == EINTR)
+            continue;
+        if(r <= 0)
+            return !line.empty();
+        if(c == '\n')
+            return true;
+        line += c;
+    }
+    return false;
+}
+
+static void writeLine(int fd, std::string const &line) {
+    auto data = line + "\n";
+    if(write(fd, data.data(), data.size()) != (ssize_t)data.size())
+        Log::warn(TAG, "Failed to reply: %s", strerror(errno));
+}
+
+// Names of the threads besides the calling one, only the calling thread survives a fork and locks held by the others would stay locked forever
+static std::vector<std::string> getOtherThreads() {
+    std::vector<std::string> threads;
+#ifdef __linux__
+    DIR *dir = opendir("/proc/self/task");
+    if(!dir)
+        return threads;
+    auto self = std::to_string((long)syscall(SYS_gettid));
+    while(auto entry = readdir(dir)) {
+        if(entry->d_name[0] == '.' || self == entry->d_name)
+            continue;
+        std::string name = entry->d_name;
+        int fd = open(("/proc/self/task/" + name + "/comm").c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd >= 0) {
+            readLine(fd, name);
+            close(fd);
+            name = std::string(entry->d_name) + " (" + name + ")";
+        }
+        threads.push_back(name);
+    }
+    closedir(dir);
+#elif defined(__APPLE__)
+    thread_act_array_t list;
+    mach_msg_type_number_t count;
+    if(task_threads(mach_task_self(), &list, &count) != KERN_SUCCESS)
+        return threads;
+    for(mach_msg_type_number_t i = 0; i < count; i++)
+        mach_port_deallocate(mach_task_self(), list[i]);
+    vm_deallocate(mach_task_self(), (vm_address_t)list, count * sizeof(*list));
+    for(mach_msg_type_number_t i = 1; i < count; i++)
+        threads.push_back("thread " + std::to_string(i));
+#endif
+    return threads;
+}
+
+static bool isSameUser(int conn) {
+#ifdef __linux__
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    if(getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+        return false;
+    return cred.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if(getpeereid(conn, &uid, &gid) != 0)
+        return false;
+    return uid == getuid();
+#endif
+}
+
+std::string Zygote::run(std::string const &socketPath) {
+    auto threads = getOtherThreads();
+    if(!threads.empty()) {
+        std::string names;
+        for(auto &&thread : threads)
+            names += (names.empty() ? "" : ", ") + thread;
+        throw std::runtime_error("The game or a mod started threads before the fork, the instances could deadlock on their locks: " + names);
+    }
+    auto addr = getAddress(socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+        throw std::runtime_error(std::string("Failed to create the zygote socket: ") + strerror(errno));
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    unlink(socketPath.c_str());
+    // Only the user running the zygote may request instances
+    auto oldMask = umask(0177);
+    bool bound = bind(fd, (sockaddr *)&addr, sizeof(addr)) == 0;
+    umask(oldMask);
+    if(!bound || listen(fd, 16) != 0) {
+        auto error = std::string("Failed to listen on ") + socketPath + ": " + strerror(errno);
+        close(fd);
+        throw std::runtime_error(error);
+    }
+    // Instances aren't waited for, let the kernel reap them
+    signal(SIGCHLD, SIG_IGN);
+    Log::info(TAG, "Game loaded, waiting for instance requests on %s", socketPath.c_str());
+
+    while(true) {
+        int conn = accept(fd, nullptr, nullptr);
+        if(conn < 0) {
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+            auto error = std::string("accept failed: ") + strerror(errno);
+            close(fd);
+            throw std::runtime_error(error);
+        }
+        if(!isSameUser(conn)) {
+            Log::warn(TAG, "Rejected an instance request of another user");
+            writeLine(conn, "error the zygote belongs to another user");
+            close(conn);
+            continue;
+        }
+        std::string dataDir;
+        if(!readLine(conn, dataDir) || dataDir.empty() || dataDir[0] != '/') {
+            writeLine(conn, "error expected the absolute data directory of the instance");
+            close(conn);
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        pid_t pid = fork();
+        if(pid == 0) {
+            close(fd);
+            close(conn);
+            signal(SIGCHLD, SIG_DFL);
+            return dataDir;
+        }
+        if(pid < 0) {
+            writeLine(conn, std::string("error fork failed: ") + strerror(errno));
+            close(conn);
+            continue;
+        }
+        writeLine(conn, std::to_string(pid));
+        close(conn);
+        Log::info(TAG, "Started instance %d for %s in %.2f ms", (int)pid, dataDir.c_str(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+int Zygote::request(std::string const &socketPath, std::string const &dataDir) {
+    auto addr = getAddress(socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+        throw std::runtime_error(std::string("Failed to create a socket: ") + strerror(errno));
+    if(connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        auto error = std::string("Failed to connect to the zygote at ") + socketPath + ": " + strerror(errno);
+        close(fd);
+        throw std::runtime_error(error);
+    }
+    // The zygote resolves relative paths against its own working directory
+    std::string path = dataDir;
+    char cwd[4096];
+    if(!path.empty() && path[0] != '/' && getcwd(cwd, sizeof(cwd)))
+        path = std::string(cwd) + "/" + path;
+    writeLine(fd, path);
+    std::string reply;
+    bool ok = readLine(fd, reply);
+    close(fd);
+    if(!ok || reply.empty() || reply.compare(0, 6, "error ") == 0)
+        throw std::runtime_error("The zygote failed to start the instance: " + (reply.size() > 6 ? reply.substr(6) : std::string("no reply")));
+    return std::stoi(reply);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+// --zygote: loads and patches the game once, then forks a preloaded instance for each request on a unix socket.
+// A request is the data directory of the instance followed by a newline, the reply is its pid or "error <message>"
+class Zygote {
+public:
+    // Only returns in the forked instances, with the data directory they were requested for. Throws std::runtime_error
+    static std::string run(std::string const &socketPath);
+
+    // Asks the zygote listening on socketPath for an instance with this data directory, returns its pid. Throws std::runtime_error
+    static int request(std::string const &socketPath, std::string const &dataDir);
+};
@@ -0,0 +1,137 @@
+// Eviction order, byte budget and the failure paths of AssetCache
+
+#include "test_util.h"
+#include <asset_cache.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+// Counts how often the contents were loaded
+struct Loader {
+    std::atomic<int> calls{0};
+
+    std::function<std::shared_ptr<const AssetContent>()> make(std::string const &content) {
+        return [this, content]() {
+            calls++;
+            return std::make_shared<const AssetContent>(content);
+        };
+    }
+};
+
+static void testEviction() {
+    AssetCache cache(10);
+    Loader loader;
+    CHECK(std::string(cache.getOrLoad("a", loader.make("aaaa"))->data, 4) == "aaaa");
+    cache.getOrLoad("b", loader.make("bbbb"));
+    CHECK(loader.calls == 2);
+    // a becomes the most recently used, so c evicts b
+    cache.getOrLoad("a", loader.make("aaaa"));
+    CHECK(loader.calls == 2);
+    cache.getOrLoad("c", loader.make("cccc"));
+    auto stats = cache.getStats();
+    CHECK(stats.hits == 1 && stats.misses == 3 && stats.evictions == 1);
+    CHECK(stats.entries == 2 && stats.bytes == 8 && stats.byteBudget == 10);
+    cache.getOrLoad("a", loader.make("aaaa"));
+    cache.getOrLoad("c", loader.make("cccc"));
+    CHECK(loader.calls == 3);
+    cache.getOrLoad("b", loader.make("bbbb"));
+    CHECK(loader.calls == 4);
+
+    // Shrinking the budget evicts the least recently used entries right away
+    cache.setByteBudget(4);
+    stats = cache.getStats();
+    CHECK(stats.entries == 1 && stats.bytes == 4);
+    cache.getOrLoad("b", loader.make("bbbb"));
+    CHECK(loader.calls == 4);
+
+    // 0 disables the cache
+    cache.setByteBudget(0);
+    CHECK(cache.getStats().entries == 0 && cache.getStats().bytes == 0);
+    cache.getOrLoad("b", loader.make("bbbb"));
+    cache.getOrLoad("b", loader.make("bbbb"));
+    CHECK(loader.calls == 6);
+}
+
+static void testNotCached() {
+    AssetCache cache(10);
+    Loader loader;
+    // Too large for the budget, empty, or failed to open
+    cache.getOrLoad("big", loader.make(std::string(11, 'x')));
+    cache.getOrLoad("big", loader.make(std::string(11, 'x')));
+    cache.getOrLoad("empty", loader.make(""));
+    cache.getOrLoad("empty", loader.make(""));
+    CHECK(loader.calls == 4);
+    int nullCalls = 0;
+    auto null = [&]() {
+        nullCalls++;
+        return std::shared_ptr<const AssetContent>();
+    };
+    CHECK(cache.getOrLoad("missing", null) == nullptr);
+    CHECK(cache.getOrLoad("missing", null) == nullptr);
+    CHECK(nullCalls == 2);
+    auto stats = cache.getStats();
+    CHECK(stats.entries == 0 && stats.bytes == 0 && stats.evictions == 0);
+}
+
+static void testLoadThrows() {
+    AssetCache cache(10);
+    int calls = 0;
+    auto failing = [&]() -> std::shared_ptr<const AssetContent> {
+        calls++;
+        throw std::runtime_error("read failed");
+    };
+    CHECK_THROWS(cache.getOrLoad("a", failing), std::runtime_error);
+    CHECK(cache.getStats().entries == 0);
+    // The next open loads again instead of returning the failure
+    Loader loader;
+    CHECK(cache.getOrLoad("a", loader.make("aaaa"))->size == 4);
+    CHECK(calls == 1 && loader.calls == 1);
+}
+
+// A second thread missing on a path which is still loading waits for that load instead of loading it again
+static void testConcurrentLoad(bool fail) {
+    AssetCache cache(10);
+    std::atomic_bool loading{false};
+    std::atomic<int> calls{0};
+    auto slow = [&]() -> std::shared_ptr<const AssetContent> {
+        calls++;
+        loading = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if(fail)
+            throw std::runtime_error("read failed");
+        return std::make_shared<const AssetContent>(std::string("aaaa"));
+    };
+    bool firstThrew = false;
+    std::thread first([&]() {
+        try {
+            cache.getOrLoad("a", slow);
+        } catch(std::runtime_error &) {
+            firstThrew = true;
+        }
+    });
+    while(!loading)
+        std::this_thread::yield();
+    std::shared_ptr<const AssetContent> content;
+    bool secondThrew = false;
+    try {
+        content = cache.getOrLoad("a", slow);
+    } catch(std::runtime_error &) {
+        secondThrew = true;
+    }
+    first.join();
+    CHECK(calls == 1);
+    CHECK(cache.getStats().hits == 1);
+    CHECK(firstThrew == fail && secondThrew == fail);
+    CHECK(fail ? content == nullptr : content && content->size == 4);
+    CHECK(cache.getStats().entries == (fail ? 0u : 1u));
+}
+
+int main() {
+    testEviction();
+    testNotCached();
+    testLoadThrows();
+    testConcurrentLoad(false);
+    testConcurrentLoad(true);
+    return 0;
+}
@@ -0,0 +1,77 @@
+// AssetIndex::normalizePath and the shadowing between the layers of the index
+
+#include "test_util.h"
+#include <asset_index.h>
+#include <algorithm>
+
+static void testNormalizePath() {
+    CHECK(AssetIndex::normalizePath("") == "");
+    CHECK(AssetIndex::normalizePath("/") == "");
+    CHECK(AssetIndex::normalizePath("a/b.json") == "a/b.json");
+    CHECK(AssetIndex::normalizePath("./a//b.json") == "a/b.json");
+    CHECK(AssetIndex::normalizePath("a/b/") == "a/b");
+    CHECK(AssetIndex::normalizePath("/a/b") == "a/b");
+    CHECK(AssetIndex::normalizePath("a/./b/../c") == "a/c");
+    CHECK(AssetIndex::normalizePath("a/b/../../c") == "c");
+    // Never above the root
+    CHECK(AssetIndex::normalizePath("../../a") == "a");
+    CHECK(AssetIndex::normalizePath("a/../../b") == "b");
+    CHECK(AssetIndex::normalizePath("..") == "");
+    // Only whole components are special
+    CHECK(AssetIndex::normalizePath("a..b/.c/..d") == "a..b/.c/..d");
+}
+
+static size_t countChild(AssetIndex::Entry const *dir, std::string const &name) {
+    return (size_t)std::count(dir->children.begin(), dir->children.end(), name);
+}
+
+static void testLayers() {
+    TempDir tmp;
+    std::string overlay = tmp.getPath() + "overlay/", base = tmp.getPath() + "base/";
+    tmp.writeFile("overlay/textures/a.png", "overlay a");
+    tmp.writeFile("overlay/ui", "a file shadowing a directory");
+    tmp.writeFile("base/textures/a.png", "base a");
+    tmp.writeFile("base/textures/b.png", "base b");
+    tmp.writeFile("base/ui/screen.json", "{}");
+    ZipWriter zip;
+    zip.add("textures/a.png", "archive a");
+    zip.add("textures/c.png", "archive c");
+    zip.add("sounds/d.ogg", "archive d");
+    auto archivePath = tmp.writeFile("assets.zip", zip.finish());
+    ZipAssetArchive archive(archivePath);
+
+    AssetIndex index;
+    CHECK(!index.addDirectory(tmp.getPath() + "missing/"));
+    CHECK(index.addDirectory(overlay));
+    CHECK(index.addDirectory(base));
+    index.addArchive(archive);
+
+    auto a = index.find("textures/a.png");
+    CHECK(a && !a->directory && a->rootDir == &overlay && a->size == 9);
+    auto b = index.find("textures/b.png");
+    CHECK(b && b->rootDir == &base && b->size == 6);
+    auto c = index.find("textures/c.png");
+    CHECK(c && c->rootDir == nullptr && c->archive == &archive && c->archiveEntry->name == "textures/c.png" && c->size == 9);
+    CHECK(index.find("sounds/d.ogg") && index.find("sounds/d.ogg")->archive == &archive);
+
+    // Directories of all layers merge, every child is listed once
+    auto textures = index.find("textures");
+    CHECK(textures && textures->directory && textures->children.size() == 3);
+    CHECK(countChild(textures, "a.png") == 1 && countChild(textures, "b.png") == 1 && countChild(textures, "c.png") == 1);
+    auto root = index.find("");
+    CHECK(root && root->directory && countChild(root, "textures") == 1 && countChild(root, "sounds") == 1);
+
+    // A file hides a directory of the same name and everything below it
+    auto ui = index.find("ui");
+    CHECK(ui && !ui->directory && ui->rootDir == &overlay);
+    CHECK(index.find("ui/screen.json") == nullptr);
+
+    CHECK(index.find("textures/missing.png") == nullptr);
+    CHECK(index.find("textures/") == nullptr);
+}
+
+int main() {
+    testNormalizePath();
+    testLayers();
+    return 0;
+}
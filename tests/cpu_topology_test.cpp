@@ -0,0 +1,82 @@
+// CpuTopology::parse and formatList, and the files written for the game
+
+#include "test_util.h"
+#include <cpu_topology.h>
+#include <sstream>
+#include <stdexcept>
+
+static std::string readFile(std::string const &path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static void testFormatList() {
+    CHECK(CpuTopology::formatList({}) == "");
+    CHECK(CpuTopology::formatList({0}) == "0");
+    CHECK(CpuTopology::formatList({0, 1, 2, 3}) == "0-3");
+    CHECK(CpuTopology::formatList({0, 2, 4}) == "0,2,4");
+    CHECK(CpuTopology::formatList({0, 1, 2, 3, 6, 8, 9}) == "0-3,6,8-9");
+}
+
+static void testParse() {
+    auto host = CpuTopology::getHostCpus();
+    CHECK(!host.empty());
+    CHECK(CpuTopology::parse("") == host);
+
+    CHECK(CpuTopology::parse("0-3,6") == std::vector<int>({0, 1, 2, 3, 6}));
+    CHECK(CpuTopology::parse("6,0-1,1") == std::vector<int>({0, 1, 6}));
+    CHECK(CpuTopology::parse("3-3") == std::vector<int>({3}));
+    // A single number with a separator is a cpu, without one a count
+    CHECK(CpuTopology::parse("2,") == std::vector<int>({2}));
+
+    // A count takes the first host cpus and makes up the ones the host doesn't have
+    auto one = CpuTopology::parse("1");
+    CHECK(one.size() == 1 && one[0] == host[0]);
+    auto more = CpuTopology::parse(std::to_string(host.size() + 2));
+    CHECK(more.size() == host.size() + 2);
+    CHECK(std::equal(host.begin(), host.end(), more.begin()));
+    CHECK(more[host.size()] == host.back() + 1 && more[host.size() + 1] == host.back() + 2);
+
+    CHECK_THROWS(CpuTopology::parse("0"), std::invalid_argument);
+    CHECK_THROWS(CpuTopology::parse("abc"), std::invalid_argument);
+    CHECK_THROWS(CpuTopology::parse("-1"), std::invalid_argument);
+    CHECK_THROWS(CpuTopology::parse("3-1"), std::invalid_argument);
+    CHECK_THROWS(CpuTopology::parse("0-"), std::invalid_argument);
+    CHECK_THROWS(CpuTopology::parse("0,,1"), std::invalid_argument);
+    CHECK_THROWS(CpuTopology::parse("99999"), std::invalid_argument);
+}
+
+static void testWriteFakeFiles() {
+    TempDir tmp;
+    auto fakeproc = tmp.getPath() + "proc/", fakesys = tmp.getPath() + "sys/";
+    CpuTopology::writeFakeFiles({0, 1, 2, 3, 6}, fakeproc, fakesys);
+    // A later launch with fewer cpus
+    CpuTopology::writeFakeFiles({0, 1}, fakeproc, fakesys);
+
+    auto fakeCpu = fakesys + "devices/system/cpu/";
+    CHECK(readFile(fakeCpu + "present") == "0-1");
+    CHECK(readFile(fakeCpu + "possible") == "0-1");
+    CHECK(readFile(fakeCpu + "online") == "0-1");
+    auto cpuinfo = readFile(fakeproc + "cpuinfo");
+    size_t processors = 0;
+    std::stringstream lines(cpuinfo);
+    for(std::string line; std::getline(lines, line);) {
+        if(line.compare(0, 9, "processor") == 0)
+            processors++;
+    }
+    CHECK(processors == 2);
+    // Nothing is left of the cpus of the earlier launch
+    for(int cpu : {2, 3, 6}) {
+        struct stat st;
+        CHECK(lstat((fakeCpu + "cpu" + std::to_string(cpu)).c_str(), &st) != 0);
+    }
+}
+
+int main() {
+    testFormatList();
+    testParse();
+    testWriteFakeFiles();
+    return 0;
+}
@@ -0,0 +1,257 @@
+// FakeInputQueue as the game sees it: arrival order, the readable fd, a full ring, coalesced moves and multi touch events
+
+#include "test_util.h"
+#include <fake_inputqueue.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static bool isReadable(int fd) {
+    pollfd p = {fd, POLLIN, 0};
+    return poll(&p, 1, 0) == 1;
+}
+
+static FakeKeyEvent key(int32_t keyCode) {
+    return FakeKeyEvent(AKEY_EVENT_ACTION_DOWN, keyCode, 0);
+}
+
+// Takes the front event off the queue
+static FakeInputEvent *next(FakeInputQueue &queue) {
+    FakeInputEvent *event = nullptr;
+    CHECK(queue.getEvent(&event) == 0 && event);
+    queue.finishEvent(event);
+    return event;
+}
+
+static void testOrder() {
+    FakeInputQueue queue;
+    FakeInputEvent *event = nullptr;
+    CHECK(queue.getEvent(&event) == -1);
+    CHECK(!queue.hasEvents() && !isReadable(queue.getFd()));
+
+    queue.addEvent(key(1));
+    queue.addEvent(FakeMotionEvent(AINPUT_SOURCE_MOUSE, AMOTION_EVENT_ACTION_DOWN, 0, 5.f, 6.f));
+    queue.addEvent(key(2));
+    CHECK(queue.hasEvents() && isReadable(queue.getFd()));
+
+    // The front event stays until it is finished
+    CHECK(queue.getEvent(&event) == 0 && event->type == AINPUT_EVENT_TYPE_KEY);
+    FakeInputEvent *again = nullptr;
+    CHECK(queue.getEvent(&again) == 0 && again == event);
+    CHECK(((FakeKeyEvent *)event)->keyCode == 1);
+    int64_t firstTime = event->eventTime;
+    CHECK(firstTime > 0);
+    queue.finishEvent(event);
+
+    CHECK(queue.getEvent(&event) == 0 && event->type == AINPUT_EVENT_TYPE_MOTION);
+    auto motion = (FakeMotionEvent *)event;
+    CHECK(motion->action == AMOTION_EVENT_ACTION_DOWN && motion->pointers[0].x == 5.f && motion->pointers[0].y == 6.f);
+    CHECK(motion->eventTime >= firstTime);
+    // Only the front event can be finished
+    FakeKeyEvent other = key(3);
+    CHECK_THROWS(queue.finishEvent(&other), std::runtime_error);
+    queue.finishEvent(event);
+
+    auto last = next(queue);
+    CHECK(last->type == AINPUT_EVENT_TYPE_KEY && ((FakeKeyEvent *)last)->keyCode == 2);
+    CHECK(queue.getEvent(&event) == -1);
+    CHECK_THROWS(queue.finishEvent(last), std::runtime_error);
+    CHECK(!queue.hasEvents() && !isReadable(queue.getFd()));
+
+    // The fd becomes readable again with the next event
+    queue.addEvent(key(4));
+    CHECK(isReadable(queue.getFd()));
+    CHECK(((FakeKeyEvent *)next(queue))->keyCode == 4);
+}
+
+// A game which stopped reading loses the newest events, not the ones it will read next
+static void testOverflow() {
+    FakeInputQueue queue;
+    const int added = 5000;
+    for(int i = 0; i < added; i++)
+        queue.addEvent(key(i));
+    int consumed = 0;
+    FakeInputEvent *event;
+    while(queue.getEvent(&event) == 0) {
+        CHECK(((FakeKeyEvent *)event)->keyCode == consumed);
+        queue.finishEvent(event);
+        consumed++;
+    }
+    CHECK(consumed > 0 && consumed < added);
+
+    // Slots are reused once finished
+    for(int i = 0; i < consumed; i++)
+        queue.addEvent(key(i));
+    for(int i = 0; i < consumed; i++)
+        CHECK(((FakeKeyEvent *)next(queue))->keyCode == i);
+    CHECK(queue.getEvent(&event) == -1);
+}
+
+static FakeMotionEvent touchMove(float x, int32_t pointerId = 0) {
+    return FakeMotionEvent(AINPUT_SOURCE_TOUCHSCREEN, AMOTION_EVENT_ACTION_MOVE, pointerId, x, x + 1);
+}
+
+static void testCoalescing() {
+    FakeInputQueue queue;
+    FakeInputEvent *event;
+    for(int i = 1; i <= 3; i++)
+        queue.addEvent(touchMove((float)i));
+    // Moves are only visible after the window event loop iteration
+    CHECK(queue.getEvent(&event) == -1);
+    queue.flush();
+    auto move = (FakeMotionEvent *)next(queue);
+    CHECK(move->pointers[0].x == 3.f && move->pointers[0].y == 4.f);
+    CHECK(move->historySize == 2);
+    CHECK(move->history[0].x[0] == 1.f && move->history[0].y[0] == 2.f && move->history[1].x[0] == 2.f);
+    CHECK(move->history[0].eventTime <= move->history[1].eventTime && move->history[1].eventTime <= move->eventTime);
+    CHECK(queue.getEvent(&event) == -1);
+
+    // Any other event publishes the pending move first
+    queue.addEvent(touchMove(1.f));
+    queue.addEvent(key(1));
+    queue.addEvent(touchMove(2.f));
+    queue.flush();
+    CHECK(((FakeMotionEvent *)next(queue))->pointers[0].x == 1.f);
+    CHECK(next(queue)->type == AINPUT_EVENT_TYPE_KEY);
+    CHECK(((FakeMotionEvent *)next(queue))->pointers[0].x == 2.f);
+
+    // Other pointers, other sources and a changed pointer count aren't merged
+    queue.addEvent(touchMove(1.f, 0));
+    queue.addEvent(touchMove(2.f, 1));
+    queue.addEvent(FakeMotionEvent(AINPUT_SOURCE_MOUSE, AMOTION_EVENT_ACTION_HOVER_MOVE, 0, 3.f, 3.f));
+    auto twoPointers = touchMove(4.f, 1);
+    twoPointers.pointerCount = 2;
+    twoPointers.pointers[1] = {2, 5.f, 5.f};
+    queue.addEvent(twoPointers);
+    queue.flush();
+    for(float x : {1.f, 2.f, 3.f, 4.f}) {
+        auto motion = (FakeMotionEvent *)next(queue);
+        CHECK(motion->pointers[0].x == x && motion->historySize == 0);
+    }
+
+    // Relative mouse moves are deltas, merging would lose all but the last one
+    queue.addEvent(FakeMotionEvent(AINPUT_SOURCE_MOUSE_RELATIVE, AMOTION_EVENT_ACTION_MOVE, 0, 1.f, 1.f));
+    queue.addEvent(FakeMotionEvent(AINPUT_SOURCE_MOUSE_RELATIVE, AMOTION_EVENT_ACTION_MOVE, 0, 2.f, 2.f));
+    CHECK(((FakeMotionEvent *)next(queue))->pointers[0].x == 1.f);
+    CHECK(((FakeMotionEvent *)next(queue))->pointers[0].x == 2.f);
+    CHECK(queue.getEvent(&event) == -1);
+}
+
+static void testHistoryLimit() {
+    FakeInputQueue queue;
+    const size_t moves = FakeMotionEvent::maxHistorySize + 5;
+    for(size_t i = 0; i < moves; i++)
+        queue.addEvent(touchMove((float)i));
+    queue.flush();
+    // A full history starts the next event, no sample is lost
+    auto first = (FakeMotionEvent *)next(queue);
+    CHECK(first->historySize == FakeMotionEvent::maxHistorySize);
+    CHECK(first->pointers[0].x == (float)FakeMotionEvent::maxHistorySize);
+    auto second = (FakeMotionEvent *)next(queue);
+    CHECK(second->historySize == moves - FakeMotionEvent::maxHistorySize - 2);
+    CHECK(second->history[0].x[0] == (float)FakeMotionEvent::maxHistorySize + 1);
+    CHECK(second->pointers[0].x == (float)(moves - 1));
+    FakeInputEvent *event;
+    CHECK(queue.getEvent(&event) == -1);
+}
+
+// Gamepads report the state of every axis, only the latest state is kept
+static void testGamepadAxes() {
+    FakeInputQueue queue;
+    for(int i = 1; i <= 3; i++) {
+        FakeMotionEvent axes(AINPUT_SOURCE_GAMEPAD, 1, AMOTION_EVENT_ACTION_MOVE, 0, 0.f, 0.f);
+        axes.axisValues[AMOTION_EVENT_AXIS_X] = (float)i / 10;
+        axes.axisValues[AMOTION_EVENT_AXIS_RZ] = -(float)i / 10;
+        queue.addEvent(axes);
+    }
+    FakeMotionEvent otherGamepad(AINPUT_SOURCE_GAMEPAD, 2, AMOTION_EVENT_ACTION_MOVE, 0, 0.f, 0.f);
+    queue.addEvent(otherGamepad);
+    queue.flush();
+    auto axes = (FakeMotionEvent *)next(queue);
+    CHECK(axes->deviceId == 1 && axes->hasAxisValues && axes->historySize == 0);
+    CHECK(axes->axisValues[AMOTION_EVENT_AXIS_X] == 0.3f && axes->axisValues[AMOTION_EVENT_AXIS_RZ] == -0.3f);
+    CHECK(((FakeMotionEvent *)next(queue))->deviceId == 2);
+}
+
+struct MotionHooks {
+    int32_t (*getAction)(const AInputEvent *);
+    size_t (*getPointerCount)(const AInputEvent *);
+    int32_t (*getPointerId)(const AInputEvent *, size_t);
+
+    MotionHooks() {
+        std::unordered_map<std::string, void *> syms;
+        FakeInputQueue::initHybrisHooks(syms);
+        getAction = (decltype(getAction))syms.at("AMotionEvent_getAction");
+        getPointerCount = (decltype(getPointerCount))syms.at("AMotionEvent_getPointerCount");
+        getPointerId = (decltype(getPointerId))syms.at("AMotionEvent_getPointerId");
+    }
+};
+
+// Decodes the event like the game does, returns the id of the pointer the action is about
+static int32_t checkTouch(MotionHooks const &hooks, FakeMotionEvent const &event, int32_t action, std::vector<int32_t> const &ids) {
+    auto e = (const AInputEvent *)(const void *)&event;
+    int32_t encoded = hooks.getAction(e);
+    CHECK((encoded & AMOTION_EVENT_ACTION_MASK) == action);
+    CHECK(hooks.getPointerCount(e) == ids.size());
+    for(size_t i = 0; i < ids.size(); i++)
+        CHECK(hooks.getPointerId(e, i) == ids[i]);
+    size_t index = (size_t)((encoded & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK) >> AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT);
+    CHECK(index < ids.size());
+    return hooks.getPointerId(e, index);
+}
+
+static void testTouchPointers() {
+    MotionHooks hooks;
+    FakeTouchPointers touch;
+    FakeMotionEvent event;
+    CHECK(touch.down(10, 1.f, 2.f, event));
+    CHECK(checkTouch(hooks, event, AMOTION_EVENT_ACTION_DOWN, {10}) == 10);
+    CHECK(event.source == AINPUT_SOURCE_TOUCHSCREEN && event.pointers[0].x == 1.f && event.pointers[0].y == 2.f);
+    CHECK(touch.down(20, 3.f, 4.f, event));
+    CHECK(checkTouch(hooks, event, AMOTION_EVENT_ACTION_POINTER_DOWN, {10, 20}) == 20);
+    CHECK(touch.down(30, 5.f, 6.f, event));
+    CHECK(checkTouch(hooks, event, AMOTION_EVENT_ACTION_POINTER_DOWN, {10, 20, 30}) == 30);
+
+    CHECK(touch.move(20, 7.f, 8.f, event));
+    checkTouch(hooks, event, AMOTION_EVENT_ACTION_MOVE, {10, 20, 30});
+    CHECK(event.pointers[1].x == 7.f && event.pointers[1].y == 8.f && event.pointers[0].x == 1.f);
+
+    // The up still reports the pointer which goes up, at its last position
+    CHECK(touch.up(20, 9.f, 10.f, event));
+    CHECK(checkTouch(hooks, event, AMOTION_EVENT_ACTION_POINTER_UP, {10, 20, 30}) == 20);
+    CHECK(event.pointers[1].x == 9.f);
+    CHECK(touch.size() == 2 && !touch.contains(20));
+
+    // Later pointers get the next free index at the end
+    CHECK(touch.down(40, 0.f, 0.f, event));
+    CHECK(checkTouch(hooks, event, AMOTION_EVENT_ACTION_POINTER_DOWN, {10, 30, 40}) == 40);
+    CHECK(touch.up(10, 0.f, 0.f, event));
+    CHECK(checkTouch(hooks, event, AMOTION_EVENT_ACTION_POINTER_UP, {10, 30, 40}) == 10);
+    CHECK(!touch.move(10, 0.f, 0.f, event) && !touch.up(10, 0.f, 0.f, event));
+    CHECK(touch.up(40, 0.f, 0.f, event));
+    CHECK(checkTouch(hooks, event, AMOTION_EVENT_ACTION_POINTER_UP, {30, 40}) == 40);
+    CHECK(touch.up(30, 0.f, 0.f, event));
+    CHECK(checkTouch(hooks, event, AMOTION_EVENT_ACTION_UP, {30}) == 30);
+    CHECK(touch.size() == 0);
+
+    // Pointers beyond what an event can report are ignored until they go up
+    for(int32_t id = 0; id < (int32_t)FakeMotionEvent::maxPointers; id++)
+        CHECK(touch.down(id, 0.f, 0.f, event));
+    CHECK(!touch.down(100, 0.f, 0.f, event) && !touch.contains(100));
+    CHECK(!touch.up(100, 0.f, 0.f, event));
+    CHECK(touch.up(0, 0.f, 0.f, event));
+    CHECK(touch.down(100, 0.f, 0.f, event));
+    CHECK(checkTouch(hooks, event, AMOTION_EVENT_ACTION_POINTER_DOWN, {1, 2, 3, 4, 5, 6, 7, 8, 9, 100}) == 100);
+}
+
+int main() {
+    testOrder();
+    testOverflow();
+    testCoalescing();
+    testHistoryLimit();
+    testGamepadAxes();
+    testTouchPointers();
+    return 0;
+}
@@ -0,0 +1,19 @@
+// Shared libraries for game_library_probe_test, the fixture links against the GLES stub like the game does
+
+#ifdef FIXTURE_GLES_STUB
+extern "C" void glDrawArrays(unsigned /*mode*/, int /*first*/, int /*count*/) {}
+#else
+extern "C" void glDrawArrays(unsigned mode, int first, int count);
+extern "C" void _ZN4FMOD6System4initEijPv();
+extern "C" __attribute__((weak)) void optional_function();
+
+extern "C" void mod_init() {
+    glDrawArrays(4, 0, 3);
+    _ZN4FMOD6System4initEijPv();
+    if(optional_function)
+        optional_function();
+}
+
+extern "C" int unwatched_export;
+int unwatched_export;
+#endif
@@ -0,0 +1,51 @@
+// GameLibraryProbe against a small library built next to the test, its path is the first argument
+
+#include "test_util.h"
+#include <game_library_probe.h>
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+static bool contains(std::vector<std::string> const &list, std::string const &value) {
+    return std::find(list.begin(), list.end(), value) != list.end();
+}
+
+static void testFixture(std::string const &path) {
+    GameLibraryProbe probe(path, {"mod_init", "mod_preinit"});
+    CHECK(contains(probe.getNeededLibraries(), "libGLESv2.so"));
+    CHECK(contains(probe.getImportedSymbols(), "glDrawArrays"));
+    CHECK(contains(probe.getImportedSymbols(), "_ZN4FMOD6System4initEijPv"));
+    // Weak imports don't fail the load, exports aren't imports
+    CHECK(!contains(probe.getImportedSymbols(), "optional_function"));
+    CHECK(!contains(probe.getImportedSymbols(), "mod_init"));
+    CHECK(probe.getImportedSymbolsContaining("FMOD") == std::vector<std::string>{"_ZN4FMOD6System4initEijPv"});
+    CHECK(probe.importsGLES());
+    CHECK(!probe.usesRenderDragon());
+    CHECK(probe.exports("mod_init"));
+    CHECK(!probe.exports("mod_preinit"));
+    // Only watched exports are recorded
+    CHECK(!probe.exports("unwatched_export"));
+    // Linked with --build-id
+    CHECK(!probe.getBuildId().empty() && probe.getBuildId().size() % 2 == 0);
+    CHECK(std::all_of(probe.getBuildId().begin(), probe.getBuildId().end(), [](char c) { return isxdigit((unsigned char)c); }));
+}
+
+static void testInvalid() {
+    TempDir tmp;
+    CHECK_THROWS(GameLibraryProbe(tmp.getPath() + "missing.so"), std::runtime_error);
+    CHECK_THROWS(GameLibraryProbe(tmp.writeFile("empty.so", "")), std::runtime_error);
+    CHECK_THROWS(GameLibraryProbe(tmp.writeFile("text.so", std::string(256, 'x'))), std::runtime_error);
+    // An ELF header with nothing behind it
+    std::string header(64, '\0');
+    memcpy(&header[0], "\x7f" "ELF\x02\x01\x01", 7);
+    header[16] = 3;  // ET_DYN
+    header[40] = (char)0xFF;  // section headers far past the end
+    CHECK_THROWS(GameLibraryProbe(tmp.writeFile("truncated.so", header)), std::runtime_error);
+}
+
+int main(int argc, char **argv) {
+    CHECK(argc == 2);
+    testFixture(argv[1]);
+    testInvalid();
+    return 0;
+}
@@ -0,0 +1,108 @@
+// Every PatternScanner implementation the cpu supports has to find exactly the matches of a brute force search
+
+#include "test_util.h"
+#include <pattern_scanner.h>
+#include <random>
+#include <stdexcept>
+
+struct ReferencePattern {
+    std::vector<int> bytes;  // -1 for ??
+};
+
+static ReferencePattern parse(std::string const &pattern) {
+    ReferencePattern ret;
+    for(size_t i = 0; i + 1 < pattern.size(); i += 3)
+        ret.bytes.push_back(pattern[i] == '?' ? -1 : (int)strtoul(pattern.substr(i, 2).c_str(), nullptr, 16));
+    return ret;
+}
+
+static std::vector<PatternScanner::Match> bruteForce(std::vector<ReferencePattern> const &patterns, std::vector<unsigned char> const &data) {
+    std::vector<PatternScanner::Match> ret;
+    for(size_t offset = 0; offset < data.size(); offset++) {
+        for(size_t p = 0; p < patterns.size(); p++) {
+            auto &bytes = patterns[p].bytes;
+            if(offset + bytes.size() > data.size())
+                continue;
+            bool match = true;
+            for(size_t i = 0; i < bytes.size() && match; i++)
+                match = bytes[i] < 0 || bytes[i] == data[offset + i];
+            if(match)
+                ret.push_back({p, offset});
+        }
+    }
+    return ret;
+}
+
+static const PatternScanner::Implementation implementations[] = {
+    PatternScanner::Implementation::SCALAR,
+    PatternScanner::Implementation::SSE2,
+    PatternScanner::Implementation::AVX2,
+    PatternScanner::Implementation::NEON,
+    PatternScanner::Implementation::AUTO,
+};
+
+static void checkAll(PatternScanner const &scanner, std::vector<ReferencePattern> const &patterns, std::vector<unsigned char> const &data) {
+    auto expected = bruteForce(patterns, data);
+    for(auto implementation : implementations) {
+        if(!PatternScanner::isSupported(implementation)) {
+            CHECK_THROWS(scanner.scan(data.data(), data.size(), implementation), std::invalid_argument);
+            continue;
+        }
+        auto matches = scanner.scan(data.data(), data.size(), implementation);
+        if(matches.size() != expected.size())
+            fprintf(stderr, "%s: %zu matches instead of %zu in %zu bytes\n", PatternScanner::getName(implementation), matches.size(), expected.size(), data.size());
+        CHECK(matches.size() == expected.size());
+        for(size_t i = 0; i < matches.size(); i++)
+            CHECK(matches[i].pattern == expected[i].pattern && matches[i].offset == expected[i].offset);
+    }
+}
+
+int main() {
+    // Leading and trailing wildcards, a single fixed byte, repeated bytes which overlap with themselves
+    std::vector<std::string> sources = {
+        "53 83 EC 18 E8 ?? ?? ?? ?? 5B",
+        "?? ?? 8B 45",
+        "8B 45 ?? ??",
+        "E8",
+        "?? 00 ?? 00 ??",
+        "55 55 55",
+        "C3 ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? 90",
+    };
+    PatternScanner scanner;
+    std::vector<ReferencePattern> patterns;
+    for(auto &&source : sources) {
+        CHECK(scanner.add(source) == patterns.size());
+        patterns.push_back(parse(source));
+    }
+    CHECK(scanner.size() == sources.size());
+
+    // Few distinct bytes, so every pattern matches often, at every alignment and around the vector widths
+    std::mt19937 rng(1234);
+    const unsigned char alphabet[] = {0x00, 0x55, 0x8B, 0x45, 0xE8, 0xC3, 0x90, 0x53, 0x83, 0xEC, 0x18, 0x5B};
+    auto randomData = [&](size_t size) {
+        std::vector<unsigned char> data(size);
+        for(auto &b : data)
+            b = alphabet[rng() % sizeof(alphabet)];
+        return data;
+    };
+    for(size_t size = 0; size <= 200; size++)
+        checkAll(scanner, patterns, randomData(size));
+    for(int i = 0; i < 20; i++)
+        checkAll(scanner, patterns, randomData(4096 + rng() % 4096));
+
+    // A match ending exactly at the end of the buffer
+    auto data = randomData(100);
+    const unsigned char tail[] = {0x53, 0x83, 0xEC, 0x18, 0xE8, 1, 2, 3, 4, 0x5B};
+    std::copy(tail, tail + sizeof(tail), data.end() - sizeof(tail));
+    checkAll(scanner, patterns, data);
+
+    PatternScanner empty;
+    CHECK(empty.scan(data.data(), data.size()).empty());
+
+    CHECK_THROWS(scanner.add("?? ??"), std::invalid_argument);
+    CHECK_THROWS(scanner.add(""), std::invalid_argument);
+    CHECK_THROWS(scanner.add("8B 4"), std::invalid_argument);
+    CHECK_THROWS(scanner.add("8B XY"), std::invalid_argument);
+    CHECK(scanner.size() == sources.size());
+    return 0;
+}
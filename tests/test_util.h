@@ -0,0 +1,181 @@
+#pragma once
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Unlike assert this also checks in release builds, a test fails with the first failed check
+#define CHECK(cond)                                                                    \
+    do {                                                                               \
+        if(!(cond)) {                                                                  \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                   \
+        }                                                                              \
+    } while(0)
+
+#define CHECK_THROWS(expr, type)      \
+    do {                              \
+        bool thrown = false;          \
+        try {                         \
+            expr;                     \
+        } catch(type &) {             \
+            thrown = true;            \
+        }                             \
+        CHECK(thrown && #expr);       \
+    } while(0)
+
+// Directory below TMPDIR which is removed with everything in it at the end of the test
+class TempDir {
+    std::string path;
+
+    // Symlinks are removed, not followed
+    static void remove(std::string const &path) {
+        struct stat st;
+        if(lstat(path.c_str(), &st) != 0)
+            return;
+        if(!S_ISDIR(st.st_mode)) {
+            unlink(path.c_str());
+        } else if(DIR *d = opendir(path.c_str())) {
+            while(dirent *ent = readdir(d)) {
+                if(strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0)
+                    remove(path + "/" + ent->d_name);
+            }
+            closedir(d);
+            rmdir(path.c_str());
+        }
+    }
+
+public:
+    TempDir() {
+        const char *tmp = getenv("TMPDIR");
+        std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/mcpelauncher-test-XXXXXX";
+        CHECK(mkdtemp(&pattern[0]) != nullptr);
+        path = pattern + "/";
+    }
+
+    TempDir(TempDir const &) = delete;
+
+    ~TempDir() {
+        remove(path.substr(0, path.size() - 1));
+    }
+
+    // With a trailing slash
+    std::string const &getPath() const { return path; }
+
+    // Creates the parent directories of name as well
+    std::string writeFile(std::string const &name, std::string const &content) const {
+        for(size_t slash = name.find('/'); slash != std::string::npos; slash = name.find('/', slash + 1))
+            mkdir((path + name.substr(0, slash)).c_str(), 0755);
+        std::ofstream(path + name, std::ios::binary) << content;
+        return path + name;
+    }
+};
+
+// Writes a zip of stored entries, optionally with the zip64 records an archive with more than 64k entries or 4GiB needs
+class ZipWriter {
+    std::string data, centralDirectory;
+    size_t count = 0;
+    bool zip64;
+
+    static void put16(std::string &out, uint16_t v) {
+        out += (char)(v & 0xFF);
+        out += (char)(v >> 8);
+    }
+
+    static void put32(std::string &out, uint32_t v) {
+        put16(out, (uint16_t)v);
+        put16(out, (uint16_t)(v >> 16));
+    }
+
+    static void put64(std::string &out, uint64_t v) {
+        put32(out, (uint32_t)v);
+        put32(out, (uint32_t)(v >> 32));
+    }
+
+public:
+    explicit ZipWriter(bool zip64 = false) : zip64(zip64) {}
+
+    void add(std::string const &name, std::string const &content) {
+        uint64_t offset = data.size();
+        put32(data, 0x04034b50);
+        put16(data, 20);
+        put16(data, 0);
+        put16(data, 0);  // stored
+        put32(data, 0);
+        put32(data, 0);  // crc isn't checked
+        put32(data, (uint32_t)content.size());
+        put32(data, (uint32_t)content.size());
+        put16(data, (uint16_t)name.size());
+        put16(data, 0);
+        data += name;
+        data += content;
+
+        std::string extra;
+        if(zip64) {
+            put16(extra, 0x0001);
+            put16(extra, 24);
+            put64(extra, content.size());
+            put64(extra, content.size());
+            put64(extra, offset);
+        }
+        auto &cd = centralDirectory;
+        put32(cd, 0x02014b50);
+        put16(cd, 45);
+        put16(cd, 45);
+        put16(cd, 0);
+        put16(cd, 0);
+        put32(cd, 0);
+        put32(cd, 0);
+        put32(cd, zip64 ? 0xFFFFFFFF : (uint32_t)content.size());
+        put32(cd, zip64 ? 0xFFFFFFFF : (uint32_t)content.size());
+        put16(cd, (uint16_t)name.size());
+        put16(cd, (uint16_t)extra.size());
+        put16(cd, 0);
+        put16(cd, 0);
+        put16(cd, 0);
+        put32(cd, 0);
+        put32(cd, zip64 ? 0xFFFFFFFF : (uint32_t)offset);
+        cd += name;
+        cd += extra;
+        count++;
+    }
+
+    std::string finish() const {
+        std::string out = data;
+        uint64_t cdOffset = out.size();
+        out += centralDirectory;
+        if(zip64) {
+            uint64_t zip64Offset = out.size();
+            put32(out, 0x06064b50);
+            put64(out, 44);
+            put16(out, 45);
+            put16(out, 45);
+            put32(out, 0);
+            put32(out, 0);
+            put64(out, count);
+            put64(out, count);
+            put64(out, centralDirectory.size());
+            put64(out, cdOffset);
+            put32(out, 0x07064b50);
+            put32(out, 0);
+            put64(out, zip64Offset);
+            put32(out, 1);
+        }
+        put32(out, 0x06054b50);
+        put16(out, 0);
+        put16(out, 0);
+        put16(out, zip64 ? 0xFFFF : (uint16_t)count);
+        put16(out, zip64 ? 0xFFFF : (uint16_t)count);
+        put32(out, zip64 ? 0xFFFFFFFF : (uint32_t)centralDirectory.size());
+        put32(out, zip64 ? 0xFFFFFFFF : (uint32_t)cdOffset);
+        put16(out, 0);
+        return out;
+    }
+};
@@ -0,0 +1,73 @@
+// Central directory parsing of ZipAssetArchive, with and without the zip64 records
+
+#include "test_util.h"
+#include <zip_asset_archive.h>
+#include <stdexcept>
+
+static void checkEntries(ZipAssetArchive const &archive, std::string const &firstName) {
+    auto &entries = archive.getEntries();
+    CHECK(entries.size() == 2);
+    CHECK(entries[0].name == firstName);
+    CHECK(entries[0].method == ZipAssetArchive::STORED);
+    CHECK(entries[0].compressedSize == 5 && entries[0].uncompressedSize == 5);
+    auto data = archive.getEntryData(entries[0]);
+    CHECK(data && memcmp(data, "hello", 5) == 0);
+    CHECK(entries[1].uncompressedSize == 0);
+    CHECK(archive.getEntryData(entries[1]) != nullptr);
+}
+
+static void testZip(bool zip64) {
+    TempDir tmp;
+    ZipWriter zip(zip64);
+    zip.add("texts/en_US.lang", "hello");
+    zip.add("empty.json", "");
+    zip.add("textures/", "");  // directories are implied by their files
+    checkEntries(ZipAssetArchive(tmp.writeFile("assets.zip", zip.finish())), "texts/en_US.lang");
+}
+
+static void testApkPrefix() {
+    TempDir tmp;
+    ZipWriter zip;
+    zip.add("AndroidManifest.xml", "<manifest/>");
+    zip.add("assets/texts/en_US.lang", "hello");
+    zip.add("lib/x86_64/libminecraftpe.so", "ELF");
+    zip.add("assets/empty.json", "");
+    // Only the assets of an apk are served, without the prefix
+    checkEntries(ZipAssetArchive(tmp.writeFile("game.apk", zip.finish())), "texts/en_US.lang");
+}
+
+static void testCorrupt() {
+    TempDir tmp;
+    CHECK_THROWS(ZipAssetArchive(tmp.getPath() + "missing.zip"), std::runtime_error);
+    CHECK_THROWS(ZipAssetArchive(tmp.writeFile("short.zip", "PK")), std::runtime_error);
+    CHECK_THROWS(ZipAssetArchive(tmp.writeFile("text.zip", std::string(100, 'x'))), std::runtime_error);
+
+    ZipWriter zip;
+    zip.add("a.json", "{}");
+    std::string valid = zip.finish();
+    // Central directory offset past the end of the file
+    std::string badOffset = valid;
+    badOffset[badOffset.size() - 6] = (char)0xFF;
+    badOffset[badOffset.size() - 5] = (char)0xFF;
+    CHECK_THROWS(ZipAssetArchive(tmp.writeFile("offset.zip", badOffset)), std::runtime_error);
+    // More entries than the central directory holds
+    std::string badCount = valid;
+    badCount[badCount.size() - 12] = 2;
+    badCount[badCount.size() - 14] = 2;
+    CHECK_THROWS(ZipAssetArchive(tmp.writeFile("count.zip", badCount)), std::runtime_error);
+
+    ZipWriter zip64(true);
+    zip64.add("a.json", "{}");
+    std::string badZip64 = zip64.finish();
+    // Locator pointing somewhere else than the zip64 end of central directory
+    badZip64[badZip64.size() - 22 - 20 + 8] ^= 1;
+    CHECK_THROWS(ZipAssetArchive(tmp.writeFile("zip64.zip", badZip64)), std::runtime_error);
+}
+
+int main() {
+    testZip(false);
+    testZip(true);
+    testApkPrefix();
+    testCorrupt();
+    return 0;
+}